@@ -1,15 +1,57 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) in vec2 inPosition;
+layout(binding = 0) uniform FrameUniforms {
+    mat4 model;
+    mat4 view;
+    mat4 clip;
+
+    vec4 viewpoint;
+    vec4 light_position;
+    vec4 light_hue;
+
+    // Ambient, diffuse and specular, then shine.
+    vec4 light_intensities;
+    vec4 surface_coefficients;
+
+    float aspect_ratio;
+} frame;
+
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inNormal;
 
 layout(location = 0) out vec2 outPosition;
 layout(location = 1) out vec3 fragColor;
 
+// Same Phong model as light_source::get_lighting.
+float get_light_intensity(vec3 position, vec3 normal) {
+    vec3 light_direction = normalize(frame.light_position.xyz / frame.light_position.w - position);
+    float normal_dot_light_direction = dot(normal, light_direction);
+    vec3 reflection_direction = normalize(normal * (2.0 * normal_dot_light_direction) - light_direction);
+    vec3 viewpoint_direction = normalize(frame.viewpoint.xyz / frame.viewpoint.w - position);
+
+    vec3 components = frame.light_intensities.xyz * frame.surface_coefficients.xyz * vec3(
+        1.0,
+        max(normal_dot_light_direction, 0.0),
+        pow(max(dot(reflection_direction, viewpoint_direction), 0.0), frame.light_intensities.w));
+
+    return components.x + components.y + components.z;
+}
+
 void main() {
+    vec4 world = vec4(inPosition, 1.0) * frame.model;
+    vec4 clip = world * frame.view * frame.clip;
+    clip.x /= frame.aspect_ratio;
+
     gl_PointSize = 1.0;
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    outPosition = inPosition;
-    fragColor = inColor;
+    gl_Position = clip;
+    outPosition = clip.xy / clip.w;
+
+    if (frame.light_intensities.w > 0.0) {
+        vec3 normal = normalize((vec4(inNormal, 0.0) * frame.model).xyz);
+        fragColor = inColor * frame.light_hue.rgb * get_light_intensity(world.xyz / world.w, normal);
+    } else {
+        fragColor = inColor;
+    }
 }
@@ -7,18 +7,18 @@
 
 
 #include "app_base.hpp"
-#include "../env/assets.hpp"
+#include "../environment/mesh_cache.hpp"
 
 
 #include "../geometry/primitive/primitives.hpp"
 
 #include "../geometry/curve.hpp"
 
-#include "../geometry/wireframe.hpp"
-#include "../geometry/body.hpp"
+#include "../geometry/indexed_body.hpp"
 
 #include "../scene/camera.hpp"
 #include "../scene/light_source.hpp"
+#include "../scene/scene.hpp"
 
 
 
@@ -26,25 +26,12 @@ namespace il
 {
 	struct [[maybe_unused]] animation_app final : app_base
 	{
-		explicit animation_app(
-			const std::string& path_to_body_file = "./objects/cube.obj"
-#if !defined(NDEBUG)
-			, const std::string& path_to_reference_plane_file = "./objects/reference_plane.obj"
-#endif
-		) :
+		explicit animation_app(const std::string& path_to_body_file = "./objects/cube.obj") :
 			app_base{ "Body" },
-			body_{d3::convex_tracking_body::parse(
-				read_object_file(path_to_body_file)) }
-		{
-			body_.prune();
-			
-			body_ &= vulkan_friendly_limit;
-			
-#if !defined(NDEBUG)
-			reference_frame_ += d3::convex_tracking_body::parse(
-				read_object_file(path_to_reference_plane_file));
-#endif
-		}
+			body_id_{
+				scene_.add_body(
+					load_mesh(path_to_body_file, vulkan_friendly_limit).get_body(),
+					{ 0.6f, 0.0f, 1.0f }) } { }
 
 
 	private:
@@ -56,23 +43,27 @@ namespace il
 		static inline const rational_number frame_rate = 60.0f;
 		static inline const rational_number frame_time = 1 / static_cast<float>(frame_rate);
 
+		// Ambient, diffuse and specular coefficients of the body surface.
+		static inline const glm::vec4 surface_coefficients{ 0.1f, 0.3f, 2.0f, 0.0f };
 
-		d3::camera camera_
-		{
-                { -0.1f, 0.1f, -2.0f, 1.0f },
-                d3::camera::rotation{1.0f },
-                1.0f
-		};
 
-		d3::light_source light_source_
+		retained_scene<GraphicsVertex> scene_
 		{
-			{ -0.1f, 0.1f, -2.0f, 1.0f }
+			d3::camera
+			{
+				{ -0.1f, 0.1f, -2.0f, 1.0f },
+				d3::camera::rotation{ 1.0f },
+				1.0f
+			},
+			d3::light_source
+			{
+				{ -0.1f, 0.1f, -2.0f, 1.0f }
+			},
+			MemoryManager::max_part_vertex_count,
+			MemoryManager::max_part_index_count
 		};
-		
-#if !defined(NDEBUG)
-		d3::tracking_wireframe reference_frame_{};
-#endif
-		d3::convex_tracking_body body_;
+
+		retained_scene<GraphicsVertex>::body_id body_id_;
 
 
 		d3::curve curve_
@@ -100,6 +91,13 @@ namespace il
 					setup_movement();
 				});
 
+			// Projection follows the images drawn to, which only change size once a resize settled.
+			artist_.on_adapt(
+				[&](vk::Extent2D)
+				{
+					set_scene_for_drawing();
+				});
+
 			set_scene_for_drawing();
 		}
 
@@ -121,10 +119,10 @@ namespace il
 					curve_parameter -= 1;
 				}
 
-				camera_.set_viewpoint(
+				scene_.modify_camera().set_viewpoint(
                         d3::to_homogeneous_coordinates(curve_(curve_parameter)));
 
-				camera_.point_to(d3::camera::origin, {0.0f, 1.0f, 0.0f });
+				scene_.modify_camera().point_to(d3::camera::origin, {0.0f, 1.0f, 0.0f });
 
 				set_scene_for_drawing();
 
@@ -143,13 +141,13 @@ namespace il
 			window_->on_key(GLFW_KEY_W, GLFW_PRESS,
 				[&]()
 				{
-					camera_.move_inward(step_size);
-					if (camera_.viewpoint() < body_)
+					scene_.modify_camera().move_inward(step_size);
+					if (is_viewpoint_in_body())
 					{
 #if !defined(NDEBUG)
 						std::cout << "Step away from the body, you wretched beast!" << std::endl;
 #endif
-						camera_.move_outward(step_size);
+						scene_.modify_camera().move_outward(step_size);
 					}
 #if !defined(NDEBUG)
 					else
@@ -165,13 +163,13 @@ namespace il
 			window_->on_key(GLFW_KEY_A, GLFW_PRESS,
 				[&]()
 				{
-					camera_.move_left(step_size);
-					if (camera_.viewpoint() < body_)
+					scene_.modify_camera().move_left(step_size);
+					if (is_viewpoint_in_body())
 					{
 #if !defined(NDEBUG)
 						std::cout << "Step away from the body, you wretched beast!" << std::endl;
 #endif
-						camera_.move_right(step_size);
+						scene_.modify_camera().move_right(step_size);
 					}
 #if !defined(NDEBUG)
 					else
@@ -187,13 +185,13 @@ namespace il
 			window_->on_key(GLFW_KEY_S, GLFW_PRESS,
 				[&]()
 				{
-					camera_.move_outward(step_size);
-					if (camera_.viewpoint() < body_)
+					scene_.modify_camera().move_outward(step_size);
+					if (is_viewpoint_in_body())
 					{
 #if !defined(NDEBUG)
 						std::cout << "Step away from the body, you wretched beast!" << std::endl;
 #endif
-						camera_.move_inward(step_size);
+						scene_.modify_camera().move_inward(step_size);
 					}
 #if !defined(NDEBUG)
 					else
@@ -209,13 +207,13 @@ namespace il
 			window_->on_key(GLFW_KEY_D, GLFW_PRESS,
 				[&]()
 				{
-					camera_.move_right(step_size);
-					if (camera_.viewpoint() < body_)
+					scene_.modify_camera().move_right(step_size);
+					if (is_viewpoint_in_body())
 					{
 #if !defined(NDEBUG)
 						std::cout << "Step away from the body, you wretched beast!" << std::endl;
 #endif
-						camera_.move_left(step_size);
+						scene_.modify_camera().move_left(step_size);
 					}
 #if !defined(NDEBUG)
 					else
@@ -232,7 +230,7 @@ namespace il
 			window_->on_key(GLFW_KEY_I, GLFW_PRESS,
 				[&]()
 				{
-					camera_.view_up(angle_step);
+					scene_.modify_camera().view_up(angle_step);
 
 					set_scene_for_drawing();
 				});
@@ -241,7 +239,7 @@ namespace il
 			window_->on_key(GLFW_KEY_J, GLFW_PRESS,
 				[&]()
 				{
-					camera_.view_left(angle_step);
+					scene_.modify_camera().view_left(angle_step);
 					set_scene_for_drawing();
 				});
 
@@ -249,7 +247,7 @@ namespace il
 			window_->on_key(GLFW_KEY_K, GLFW_PRESS,
 				[&]()
 				{
-					camera_.view_down(angle_step);
+					scene_.modify_camera().view_down(angle_step);
 					set_scene_for_drawing();
 				});
 
@@ -257,310 +255,72 @@ namespace il
 			window_->on_key(GLFW_KEY_L, GLFW_PRESS,
 				[&]()
 				{
-					camera_.view_right(angle_step);
+					scene_.modify_camera().view_right(angle_step);
 					set_scene_for_drawing();
 				});
+		}
 
 
-			window_->on_resize(
-				[&](vk::Extent2D)
-				{
-					set_scene_for_drawing();
-				});
+		[[nodiscard]] bool is_viewpoint_in_body() const
+		{
+			return scene_.body(body_id_).classify(scene_.camera().viewpoint()) != containment::outside;
 		}
 
 
+		// Geometry is written only for bodies that changed, the others keep what was written for them. Camera and
+		// light only change the uniforms and which bodies are culled.
 		void set_scene_for_drawing()
 		{
-			d3::tracking_wireframe visible{};
-#if !defined(NDEBUG)
-			d3::tracking_wireframe invisible{};
-#endif
-
-			const auto view_transformation = camera_.get_view_transformation();
-			const auto viewpoint_cartesian =
-				d3::to_cartesian_coordinates(camera_.viewpoint());
-
-			std::vector<GraphicsVertex> triangle_vertices{  };
+			const auto extent = artist_.get_extent();
+			scene_.set_screen_extent(extent.width, extent.height);
 
-			for (const auto& shared_triangle : body_.triangles())
+			if (const auto changes = scene_.update(); changes.is_changed)
 			{
-				const auto triangle_first_cartesian =
-					d3::to_cartesian_coordinates(shared_triangle->first());
-				const auto triangle_second_cartesian =
-					d3::to_cartesian_coordinates(shared_triangle->second());
-				const auto triangle_third_cartesian =
-					d3::to_cartesian_coordinates(shared_triangle->third());
-
-				if (dot(
-                        d3::get_plane_normal(
-						triangle_first_cartesian,
-						triangle_second_cartesian,
-						triangle_third_cartesian),
-
-					viewpoint_cartesian -
-					(triangle_first_cartesian +
-						triangle_second_cartesian +
-						triangle_third_cartesian) / 3.0f) > 0)
-				{
-					visible += *shared_triangle;
-
-					vector<d3::dimension_count> first_normal{0.0f };
-					vector<d3::dimension_count> second_normal{0.0f };
-					vector<d3::dimension_count> third_normal{0.0f };
-
-					auto first_normal_count = small_zero;
-					auto second_normal_count = small_zero;
-					auto third_normal_count = small_zero;
-
-					for (const auto& triangle :
-						*shared_triangle->first_tracked().trackers())
-					{
-						if (!triangle.expired())
-						{
-							first_normal += triangle.lock()->get_plane_normal();
-							++first_normal_count;
-						}
-					}
-
-					for (const auto& triangle :
-						*shared_triangle->second_tracked().trackers())
-					{
-						if (!triangle.expired())
-						{
-							second_normal += triangle.lock()->get_plane_normal();
-							++second_normal_count;
-						}
-					}
-
-					for (const auto& triangle :
-						*shared_triangle->third_tracked().trackers())
-					{
-						if (!triangle.expired())
-						{
-							third_normal += triangle.lock()->get_plane_normal();
-							++third_normal_count;
-						}
-					}
-
-					first_normal /= first_normal_count;
-					second_normal /= second_normal_count;
-					third_normal /= third_normal_count;
-
-					const auto first_lighting =
-						light_source_.get_lighting(
-							camera_.viewpoint(), shared_triangle->first(), first_normal);
-					const auto second_lighting =
-						light_source_.get_lighting(
-							camera_.viewpoint(), shared_triangle->second(), second_normal);
-					const auto third_lighting =
-						light_source_.get_lighting(
-							camera_.viewpoint(), shared_triangle->third(), third_normal);
-
-					auto triangle = shared_triangle->get_detached();
-					triangle *= view_transformation;
-
-					const auto first_cartesian =
-						d3::to_cartesian_coordinates(triangle.first());
-					const auto second_cartesian =
-						d3::to_cartesian_coordinates(triangle.second());
-					const auto third_cartesian =
-						d3::to_cartesian_coordinates(triangle.third());
-
-					if (first_cartesian.z > 0 && second_cartesian.z > 0 && third_cartesian.z > 0)
-					{
-						triangle_vertices.emplace_back(
-                                GraphicsVertex
-							{
-                                    camera_.get_projection(first_cartesian),
-                                    GraphicsVertex::ColorVector{0.6f, 0.0f, 1.0f } *
-                                    first_lighting
-							});
-
-						triangle_vertices.emplace_back(
-                                GraphicsVertex
-							{
-                                    camera_.get_projection(second_cartesian),
-                                    GraphicsVertex::ColorVector{0.6f, 0.0f, 1.0f } *
-                                    second_lighting
-							});
-
-						triangle_vertices.emplace_back(
-                                GraphicsVertex
-							{
-                                    camera_.get_projection(third_cartesian),
-                                    GraphicsVertex::ColorVector{0.6f, 0.0f, 1.0f } *
-                                    third_lighting
-							});
-					}
-				}
+				std::vector<geometry_counts> parts{};
+				for (const auto& part : scene_.get_part_counts())
+					parts.emplace_back(geometry_counts{ part.vertex_count, part.index_count });
 
-#if !defined(NDEBUG)
-				else invisible += *shared_triangle;
-#endif
-
-			}
-
-			visible.prune();
-#if !defined(NDEBUG)
-			invisible.prune();
-#endif
-
-
-			std::vector<GraphicsVertex> line_vertices{  };
-
-#if !defined(NDEBUG)
-			for (const auto& shared_wire : invisible.wires())
-			{
-				auto wire = shared_wire->get_detached();
-				wire *= view_transformation;
-
-				const auto wire_begin_cartesian =
-					d3::to_cartesian_coordinates(wire.begin_owned());
-				const auto wire_end_cartesian =
-					d3::to_cartesian_coordinates(wire.end_owned());
-
-				if (wire_begin_cartesian.z > 0 && wire_end_cartesian.z > 0)
+				const auto geometry = artist_.write_geometry(parts, changes.previous_parts);
+				for (size_t i = 0; i < geometry.size(); ++i)
 				{
-					line_vertices.emplace_back(
-                            GraphicsVertex
-						{
-							camera_.get_projection(wire_begin_cartesian),
-							{0.0f, 0.3f, 0.2f}
-						});
-
-					line_vertices.emplace_back(
-                            GraphicsVertex
-						{
-							camera_.get_projection(wire_end_cartesian),
-							{0.2f, 0.0f, 0.4f}
-						});
+					if (!geometry[i].has_value()) continue;
+
+					scene_.write_part(i, geometry[i]->vertices.begin(), geometry[i]->indices.begin());
 				}
 			}
-#endif
 
-			for (const auto& shared_wire : visible.wires())
-			{
-				auto wire = shared_wire->get_detached();
-				wire *= view_transformation;
-
-				const auto wire_begin_cartesian =
-					d3::to_cartesian_coordinates(wire.begin_owned());
-				const auto wire_end_cartesian =
-					d3::to_cartesian_coordinates(wire.end_owned());
-
-				const auto begin_body = body_.vertices().find(
-                        d3::convex_tracking_body::tracked_vertex
-					{
-						shared_wire->begin_tracked().inner()
-					});
-
-				const auto end_body = body_.vertices().find(
-                        d3::convex_tracking_body::tracked_vertex
-					{
-						shared_wire->end_tracked().inner()
-					});
+			artist_.set_part_visibility(scene_.get_visible_parts());
+			artist_.set_uniforms(get_frame_uniforms());
+		}
 
-				vector<d3::dimension_count> begin_normal{0.0f };
-				vector<d3::dimension_count> end_normal{0.0f };
+		[[nodiscard]] frame_uniforms get_frame_uniforms()
+		{
+			const auto extent = artist_.get_extent();
+			const auto& light = scene_.light();
 
-				auto begin_normal_count = small_zero;
-				auto end_normal_count = small_zero;
-				
-				if (begin_body != body_.vertices().end())
-				{
-					for (const auto& triangle : *begin_body->trackers())
-					{
-						if (!triangle.expired())
-						{
-							begin_normal += triangle.lock()->get_plane_normal();
-							++begin_normal_count;
-						}
-					}
-				}
+			frame_uniforms result{};
 
-				if (end_body != body_.vertices().end())
-				{
-					for (const auto& triangle : *end_body->trackers())
-					{
-						if (!triangle.expired())
-						{
-							end_normal += triangle.lock()->get_plane_normal();
-							++end_normal_count;
-						}
-					}
-				}
+			result.view = scene_.view_transformation();
+			result.clip = scene_.clip_transformation();
 
-				begin_normal /= begin_normal_count;
-				end_normal /= end_normal_count;
-
-				const auto begin_lighting =
-					light_source_.get_lighting(
-                            camera_.viewpoint(), wire.begin_owned(), begin_normal);
-				const auto end_lighting =
-					light_source_.get_lighting(
-                            camera_.viewpoint(), wire.end_owned(), end_normal);
-				
-				if (wire_begin_cartesian.z > 0 && wire_end_cartesian.z > 0)
-				{
-					line_vertices.emplace_back(
-                            GraphicsVertex
-						{
-							camera_.get_projection(wire_begin_cartesian),
-                            begin_lighting * GraphicsVertex::ColorVector{1.0f, 0.6f, 0.0f}
-						});
-
-					line_vertices.emplace_back(
-                            GraphicsVertex
-						{
-							camera_.get_projection(wire_end_cartesian),
-                            end_lighting * GraphicsVertex::ColorVector{1.0f, 0.6f, 0.0f}
-						});
-				}
-			}
-			
-#if !defined(NDEBUG)
-			for (const auto& shared_wire : reference_frame_.wires())
+			result.viewpoint = scene_.camera().viewpoint();
+			result.light_position = light.position();
+			result.light_hue = { light.hue(), 0.0f };
+			result.light_intensities =
 			{
-				auto wire = shared_wire->get_detached();
-				wire *= view_transformation;
-
-				const auto wire_begin_cartesian =
-					d3::to_cartesian_coordinates(wire.begin_owned());
-				const auto wire_end_cartesian =
-					d3::to_cartesian_coordinates(wire.end_owned());
-
-				if (wire_begin_cartesian.z > 0 && wire_end_cartesian.z > 0)
-				{
-					line_vertices.emplace_back(
-                            GraphicsVertex
-						{
-							camera_.get_projection(wire_begin_cartesian),
-							{0.0f, 0.3f, 0.2f}
-						});
-
-					line_vertices.emplace_back(
-                            GraphicsVertex
-						{
-							camera_.get_projection(wire_end_cartesian),
-							{0.0f, 0.2f, 0.3f}
-						});
-				}
-			}
-#endif
-			
-			const auto window_extent = window_->query_extent();
-			const auto aspect_ratio = window_extent.width /
-				static_cast<float>(window_extent.height);
+				light.ambient_intensity(),
+				light.diffuse_intensity(),
+				light.specular_intensity(),
+				static_cast<float>(light.shine())
+			};
+			result.surface_coefficients = surface_coefficients;
 
-			for (auto& vertex : line_vertices) vertex.position.x /= aspect_ratio;
-			for (auto& vertex : triangle_vertices) vertex.position.x /= aspect_ratio;
+			result.aspect_ratio = extent.width /
+				static_cast<float>(extent.height);
 
-			artist_.set_vertices_to_draw(triangle_vertices);
-			// artist_.set_vertices_to_draw(line_vertices);
+			return result;
 		}
 	};
 }
 
 #endif
-
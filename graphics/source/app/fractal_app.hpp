@@ -20,7 +20,7 @@ namespace il
 			set_screen_covering_triangle_to_draw();
 		}
 
-		void set_screen_covering_triangle_to_draw() const
+		void set_screen_covering_triangle_to_draw()
 		{
 			static constexpr auto square_root_of_three = 1.73205080757f;
 			static constexpr auto two_thirds = 2.0f / 3.0f;
@@ -34,15 +34,15 @@ namespace il
 			artist_.set_vertices_to_draw(
 				{
 					{
-						{ x_mid, y_max },
+						{ x_mid, y_max, rational_zero },
 						{ 1.0f, 0.0f, 0.0f }
 					},
 					{
-						{ x_min, y_min },
+						{ x_min, y_min, rational_zero },
 						{ 1.0f, 0.0f, 0.0f }
 					},
 					{
-						{ x_max, y_min },
+						{ x_max, y_min, rational_zero },
 						{ 1.0f, 0.0f, 0.0f }
 					}
 				});
@@ -4,6 +4,10 @@
 
 #include "external/external.hpp"
 
+#include "geometry/object_parser.hpp"
+
+#include "mapped_file.hpp"
+
 
 namespace il
 {
@@ -29,31 +33,16 @@ namespace il
         return buffer;
     }
 
-    [[nodiscard, maybe_unused]] static std::vector<std::string> read_object_file(const std::string &path)
+    // The file is parsed straight from the mapped pages, without copying it into lines first.
+    [[nodiscard, maybe_unused]] inline object_description read_object_file(const std::string &path)
     {
 #if !defined (NDEBUG)
         std::cout << "Reading object file at: '" << path << "'." << std::endl;
 #endif
 
-        std::ifstream file{path};
-        if (!file.is_open())
-        {
-            throw std::runtime_error("Failed to open file from path '" + path + "'.");
-        }
-
-        std::vector<std::string> result;
-        for (std::string line ; std::getline(file, line) ;)
-        {
-            // Check if empty or contains only whitespace
-            if (!line.empty() &&
-                line.find_first_not_of(' ') != std::string::npos &&
-                line.find_first_not_of('\t') != std::string::npos)
-            {
-                result.emplace_back(line);
-            }
-        }
+        const mapped_file file{path};
 
-        return result;
+        return parse_object(file.view());
     }
 }
 
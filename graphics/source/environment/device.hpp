@@ -186,32 +186,46 @@ namespace il
         {
             il::queue_family_indices indices;
 
+            // Families that can transfer but not draw usually have copy engines of their own, which upload
+            // alongside rendering.
+            std::optional<unsigned int> dedicated_transfer_family{ };
+
             auto queue_family_index = 0;
             for (const auto &queue_family : device.getQueueFamilyProperties())
             {
-                if (device.getSurfaceSupportKHR(queue_family_index, window.drawing_surface()) == VK_TRUE)
+                if (!indices.is_complete())
                 {
-                    indices.present_family = queue_family_index;
-                }
+                    if (device.getSurfaceSupportKHR(queue_family_index, window.drawing_surface()) == VK_TRUE)
+                    {
+                        indices.present_family = queue_family_index;
+                    }
 
-                if (queue_family.queueFlags & vk::QueueFlagBits::eGraphics)
-                {
-                    indices.graphics_family = queue_family_index;
-                }
+                    if (queue_family.queueFlags & vk::QueueFlagBits::eGraphics)
+                    {
+                        indices.graphics_family = queue_family_index;
+                    }
 
-                if (queue_family.queueFlags & vk::QueueFlagBits::eTransfer)
-                {
-                    indices.transfer_family = queue_family_index;
+                    if (queue_family.queueFlags & vk::QueueFlagBits::eTransfer)
+                    {
+                        indices.transfer_family = queue_family_index;
+                    }
                 }
 
-                if (indices.is_complete())
+                if (!dedicated_transfer_family.has_value()
+                    && queue_family.queueFlags & vk::QueueFlagBits::eTransfer
+                    && !(queue_family.queueFlags & vk::QueueFlagBits::eGraphics))
                 {
-                    break;
+                    dedicated_transfer_family = queue_family_index;
                 }
 
                 queue_family_index++;
             }
 
+            if (indices.is_complete() && dedicated_transfer_family.has_value())
+            {
+                indices.transfer_family = dedicated_transfer_family;
+            }
+
             return indices;
         }
 
@@ -0,0 +1,146 @@
+#ifndef IRGLAB_MAPPED_FILE_HPP
+#define IRGLAB_MAPPED_FILE_HPP
+
+
+#include "external/external.hpp"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+// Windows headers define these as macros, which breaks il::direction.
+#undef near
+#undef far
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace il
+{
+    // Read-only view of a whole file mapped into the address space. Pages are loaded by the OS on first access,
+    // so nothing is copied into user buffers.
+    class [[maybe_unused]] mapped_file
+    {
+    public:
+        [[nodiscard, maybe_unused]] explicit mapped_file(const std::string& path) : path{path}
+        {
+#if !defined(NDEBUG)
+            std::cout << "Mapping file at: '" << path << "'." << std::endl;
+#endif
+
+#if defined(_WIN32)
+            _file = CreateFileA(
+                    path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (_file == INVALID_HANDLE_VALUE)
+            {
+                throw std::runtime_error("Failed to open file from path '" + path + "'.");
+            }
+
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(_file, &file_size))
+            {
+                CloseHandle(_file);
+                throw std::runtime_error("Failed to query size of file at '" + path + "'.");
+            }
+            _size = static_cast<size_t>(file_size.QuadPart);
+
+            if (_size > 0)
+            {
+                _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                _data = _mapping != nullptr ? MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+                if (_data == nullptr)
+                {
+                    if (_mapping != nullptr) CloseHandle(_mapping);
+                    CloseHandle(_file);
+                    throw std::runtime_error("Failed to map file from path '" + path + "'.");
+                }
+            }
+#else
+            _descriptor = open(path.c_str(), O_RDONLY);
+            if (_descriptor < 0)
+            {
+                throw std::runtime_error("Failed to open file from path '" + path + "'.");
+            }
+
+            struct stat file_status{ };
+            if (fstat(_descriptor, &file_status) != 0)
+            {
+                close(_descriptor);
+                throw std::runtime_error("Failed to query size of file at '" + path + "'.");
+            }
+            _size = static_cast<size_t>(file_status.st_size);
+
+            if (_size > 0)
+            {
+                _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _descriptor, 0);
+                if (_data == MAP_FAILED)
+                {
+                    close(_descriptor);
+                    throw std::runtime_error("Failed to map file from path '" + path + "'.");
+                }
+
+                madvise(_data, _size, MADV_SEQUENTIAL);
+            }
+#endif
+        }
+
+        [[maybe_unused]] ~mapped_file()
+        {
+#if defined(_WIN32)
+            if (_data != nullptr) UnmapViewOfFile(_data);
+            if (_mapping != nullptr) CloseHandle(_mapping);
+            if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+#else
+            if (_data != nullptr) munmap(_data, _size);
+            if (_descriptor >= 0) close(_descriptor);
+#endif
+        }
+
+        mapped_file(mapped_file&) = delete;
+        mapped_file(mapped_file&&) = delete;
+        mapped_file& operator=(mapped_file&) = delete;
+        mapped_file& operator=(mapped_file&&) = delete;
+
+
+        const std::string path;
+
+
+        [[nodiscard, maybe_unused]] const char* data() const noexcept
+        {
+            return static_cast<const char*>(_data);
+        }
+
+        [[nodiscard, maybe_unused]] size_t size() const noexcept
+        {
+            return _size;
+        }
+
+        [[nodiscard, maybe_unused]] std::string_view view() const noexcept
+        {
+            return _size > 0 ? std::string_view{data(), _size} : std::string_view{ };
+        }
+
+
+    private:
+        void* _data{nullptr};
+        size_t _size{0};
+
+#if defined(_WIN32)
+        HANDLE _file{INVALID_HANDLE_VALUE};
+        HANDLE _mapping{nullptr};
+#else
+        int _descriptor{-1};
+#endif
+    };
+}
+
+#endif
@@ -0,0 +1,414 @@
+#ifndef IRGLAB_MESH_CACHE_HPP
+#define IRGLAB_MESH_CACHE_HPP
+
+
+#include "external/external.hpp"
+
+#include "geometry/indexed_body.hpp"
+
+#include "assets.hpp"
+#include "mapped_file.hpp"
+
+
+namespace il
+{
+    // Binary layout of an '.ilmesh' file. The header is followed by sections, each starting at a multiple of
+    // section_alignment:
+    //  - x, y and z vertex coordinates (vertex_count floats each, already normalized so w is always 1),
+    //  - triangle indices (triangle_count triples of 32-bit indices),
+    //  - x, y and z unit vertex normals (vertex_count floats each), which the loaded body starts out with instead
+    //    of computing them.
+    // Everything is stored in native byte order, so a cache is only reused on the machine that wrote it.
+    struct [[maybe_unused]] mesh_cache_header
+    {
+        [[maybe_unused]] static constexpr std::array<char, 8> expected_magic{'I', 'L', 'M', 'E', 'S', 'H', 0, 0};
+        [[maybe_unused]] static constexpr std::uint32_t current_version = 2;
+
+        [[maybe_unused]] static constexpr size_t section_alignment = 64;
+
+
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t vertex_count;
+
+        std::uint32_t triangle_count;
+        rational_number limit;
+
+        // Identify the source object file the cache was built from.
+        std::uint64_t source_size;
+        std::int64_t source_write_time;
+
+        // x min, x max, y min, y max, z min, z max
+        std::array<rational_number, 6> bounds;
+    };
+
+    static_assert(sizeof(mesh_cache_header) == mesh_cache_header::section_alignment);
+    static_assert(std::is_trivially_copyable_v<mesh_cache_header>);
+    static_assert(sizeof(triangle_indices) == 3 * sizeof(vertex_index));
+
+
+    // Byte offsets of all sections for the given element counts.
+    struct [[maybe_unused]] mesh_cache_layout
+    {
+        [[nodiscard, maybe_unused]] explicit mesh_cache_layout(
+                const size_t vertex_count, const size_t triangle_count) noexcept
+        {
+            size_t offset = sizeof(mesh_cache_header);
+
+            for (auto& coordinate_offset : coordinates)
+            {
+                coordinate_offset = offset;
+                offset = _align(offset + vertex_count * sizeof(rational_number));
+            }
+
+            triangles = offset;
+            offset = _align(offset + triangle_count * sizeof(triangle_indices));
+
+            for (auto& normal_offset : normals)
+            {
+                normal_offset = offset;
+                offset = _align(offset + vertex_count * sizeof(rational_number));
+            }
+
+            size = offset;
+        }
+
+
+        std::array<size_t, d3::dimension_count> coordinates{ };
+        size_t triangles{ };
+        std::array<size_t, d3::dimension_count> normals{ };
+
+        size_t size{ };
+
+
+    private:
+        [[nodiscard]] static constexpr size_t _align(const size_t offset) noexcept
+        {
+            return (offset + mesh_cache_header::section_alignment - 1) &
+                   ~(mesh_cache_header::section_alignment - 1);
+        }
+    };
+
+
+    // Read-only mesh backed directly by the pages of a mapped '.ilmesh' file.
+    class [[maybe_unused]] mapped_mesh
+    {
+    public:
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] explicit mapped_mesh(std::unique_ptr<mapped_file> file) :
+                _file{std::move(file)}
+        {
+            if (!is_valid(*_file))
+            {
+                throw std::runtime_error("Mesh cache at '" + _file->path + "' is corrupt or outdated.");
+            }
+        }
+
+
+        [[nodiscard, maybe_unused]] static bool is_valid(const mapped_file& file) noexcept
+        {
+            if (file.size() < sizeof(mesh_cache_header)) return false;
+
+            const auto& header = *reinterpret_cast<const mesh_cache_header*>(file.data());
+            if (header.magic != mesh_cache_header::expected_magic ||
+                header.version != mesh_cache_header::current_version)
+                return false;
+
+            const mesh_cache_layout layout{header.vertex_count, header.triangle_count};
+            if (layout.size != file.size()) return false;
+
+            // A file of the right size can still have corrupt triangles, which would reference vertices past the
+            // end and make the body refuse them.
+            const auto* triangles = reinterpret_cast<const triangle_indices*>(file.data() + layout.triangles);
+            return std::all_of(
+                    triangles, triangles + header.triangle_count,
+                    [&header](const triangle_indices& indices)
+                    {
+                        return std::all_of(
+                                indices.begin(), indices.end(),
+                                [&header](const vertex_index index) { return index < header.vertex_count; });
+                    });
+        }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] const mesh_cache_header& header() const noexcept
+        {
+            return *reinterpret_cast<const mesh_cache_header*>(_file->data());
+        }
+
+        [[nodiscard, maybe_unused]] size_t vertex_count() const noexcept
+        {
+            return header().vertex_count;
+        }
+
+        [[nodiscard, maybe_unused]] size_t triangle_count() const noexcept
+        {
+            return header().triangle_count;
+        }
+
+
+        [[nodiscard, maybe_unused]] const rational_number* coordinate(const small_natural_number component) const
+        {
+            return _section<rational_number>(_layout().coordinates.at(component));
+        }
+
+        [[nodiscard, maybe_unused]] const triangle_indices* triangles() const noexcept
+        {
+            return _section<triangle_indices>(_layout().triangles);
+        }
+
+        [[nodiscard, maybe_unused]] const rational_number* normal(const small_natural_number component) const
+        {
+            return _section<rational_number>(_layout().normals.at(component));
+        }
+
+
+        [[nodiscard, maybe_unused]] d3::bounds get_bounds() const noexcept
+        {
+            const auto& bounds = header().bounds;
+
+            return d3::bounds{bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]};
+        }
+
+
+        // Non-modifiers
+
+        // The accessors above read the mapped pages in place. A body owns its arrays since it can be modified,
+        // so this is one straight copy of each section into it, including the vertex normals it would otherwise
+        // compute on first use. No parsing is needed, and the indices were checked against the vertex count when
+        // the file was mapped.
+        [[nodiscard, maybe_unused]] d3::indexed_body get_body() const
+        {
+            std::array<d3::indexed_body::coordinates, d3::indexed_body::component_count> coordinates{ };
+            for (small_natural_number component = 0 ; component < d3::dimension_count ; ++component)
+            {
+                const auto* begin = coordinate(component);
+                coordinates[component].assign(begin, begin + vertex_count());
+            }
+            coordinates[d3::dimension_count].assign(vertex_count(), rational_one);
+
+            std::vector<d3::plane_normal> vertex_normals(vertex_count());
+            for (small_natural_number component = 0 ; component < d3::dimension_count ; ++component)
+            {
+                const auto* components = normal(component);
+                for (size_t i = 0 ; i < vertex_normals.size() ; ++i) vertex_normals[i][component] = components[i];
+            }
+
+            return d3::indexed_body
+                    {
+                            std::move(coordinates),
+                            std::vector<triangle_indices>{triangles(), triangles() + triangle_count()},
+                            std::move(vertex_normals)
+                    };
+        }
+
+
+        // Implementation details
+
+    private:
+        [[nodiscard]] mesh_cache_layout _layout() const noexcept
+        {
+            return mesh_cache_layout{vertex_count(), triangle_count()};
+        }
+
+        template<typename Element>
+        [[nodiscard]] const Element* _section(const size_t offset) const noexcept
+        {
+            return reinterpret_cast<const Element*>(_file->data() + offset);
+        }
+
+
+        // Data
+
+        std::unique_ptr<mapped_file> _file;
+    };
+
+
+    // Builds a cache from a normalized body.
+    [[maybe_unused]] inline void write_mesh_cache(
+            const std::string& path,
+            const d3::indexed_body& body,
+            const rational_number limit,
+            const std::uint64_t source_size,
+            const std::int64_t source_write_time)
+    {
+#if !defined(NDEBUG)
+        std::cout << "Writing mesh cache at: '" << path << "'." << std::endl;
+#endif
+
+        const mesh_cache_layout layout{body.vertex_count(), body.triangle_count()};
+        std::vector<char> buffer(layout.size, 0);
+
+        mesh_cache_header header{ };
+        header.magic = mesh_cache_header::expected_magic;
+        header.version = mesh_cache_header::current_version;
+        header.vertex_count = static_cast<std::uint32_t>(body.vertex_count());
+        header.triangle_count = static_cast<std::uint32_t>(body.triangle_count());
+        header.limit = limit;
+        header.source_size = source_size;
+        header.source_write_time = source_write_time;
+
+        for (small_natural_number component = 0 ; component < d3::dimension_count ; ++component)
+        {
+            const auto& coordinates = body.coordinate(component);
+
+            const auto [minimum, maximum] = std::minmax_element(coordinates.begin(), coordinates.end());
+            header.bounds[2 * component] = minimum != coordinates.end() ? *minimum : rational_zero;
+            header.bounds[2 * component + 1] = maximum != coordinates.end() ? *maximum : rational_zero;
+
+            std::memcpy(
+                    buffer.data() + layout.coordinates[component],
+                    coordinates.data(), coordinates.size() * sizeof(rational_number));
+        }
+
+        std::memcpy(buffer.data(), &header, sizeof(header));
+
+        std::memcpy(
+                buffer.data() + layout.triangles,
+                body.triangles().data(), body.triangle_count() * sizeof(triangle_indices));
+
+        const auto& vertex_normals = body.get_vertex_normals();
+        for (small_natural_number component = 0 ; component < d3::dimension_count ; ++component)
+        {
+            auto* components = reinterpret_cast<rational_number*>(buffer.data() + layout.normals[component]);
+            for (size_t i = 0 ; i < vertex_normals.size() ; ++i) components[i] = vertex_normals[i][component];
+        }
+
+        // Written next to the destination and renamed, so a reader never maps a half written file.
+        const auto temporary_path = path + ".tmp";
+        {
+            std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Failed to open file from path '" + temporary_path + "'.");
+            }
+
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            if (!file)
+            {
+                throw std::runtime_error("Failed to write file at '" + temporary_path + "'.");
+            }
+        }
+
+        std::filesystem::rename(temporary_path, path);
+    }
+
+
+    // Mesh handed out by load_mesh, either mapped from its cache or, if there is no cache and none could be
+    // written, the body parsed from the object file.
+    class [[maybe_unused]] loaded_mesh
+    {
+    public:
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] explicit loaded_mesh(mapped_mesh mesh) :
+                _inner{std::move(mesh)}
+        { }
+
+        [[nodiscard, maybe_unused]] explicit loaded_mesh(d3::indexed_body body) :
+                _inner{std::move(body)}
+        { }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] bool is_mapped() const noexcept
+        {
+            return std::holds_alternative<mapped_mesh>(_inner);
+        }
+
+        // Only if it is mapped.
+        [[nodiscard, maybe_unused]] const mapped_mesh& mapped() const
+        {
+            return std::get<mapped_mesh>(_inner);
+        }
+
+
+        // Non-modifiers
+
+        [[nodiscard, maybe_unused]] d3::indexed_body get_body() const &
+        {
+            return is_mapped() ? mapped().get_body() : std::get<d3::indexed_body>(_inner);
+        }
+
+        // Hands over the parsed body instead of copying it.
+        [[nodiscard, maybe_unused]] d3::indexed_body get_body() &&
+        {
+            return is_mapped() ? mapped().get_body() : std::move(std::get<d3::indexed_body>(_inner));
+        }
+
+
+        // Implementation details
+
+    private:
+        std::variant<mapped_mesh, d3::indexed_body> _inner;
+    };
+
+
+    // Loads the object at the path pruned and fit into [-limit, limit] in each dimension.
+    // The first load parses the object file and writes '<path>.ilmesh' next to it. Later loads map that cache
+    // directly as long as the object file keeps its size and modification time and the limit is the same.
+    // A cache that can't be read or written, like one next to a read-only object file, is only skipped, so
+    // every load parses the object file then.
+    [[nodiscard, maybe_unused]] inline loaded_mesh load_mesh(const std::string& path, const rational_number limit)
+    {
+        const auto cache_path = path + ".ilmesh";
+
+        const auto source_size = static_cast<std::uint64_t>(std::filesystem::file_size(path));
+        const auto source_write_time = static_cast<std::int64_t>(
+                std::filesystem::last_write_time(path).time_since_epoch().count());
+
+        try
+        {
+            if (std::filesystem::exists(cache_path))
+            {
+                auto file = std::make_unique<mapped_file>(cache_path);
+
+                if (mapped_mesh::is_valid(*file))
+                {
+                    const auto& header = *reinterpret_cast<const mesh_cache_header*>(file->data());
+
+                    if (header.source_size == source_size &&
+                        header.source_write_time == source_write_time &&
+                        header.limit == limit)
+                        return loaded_mesh{mapped_mesh{std::move(file)}};
+                }
+            }
+        }
+#if !defined(NDEBUG)
+        catch (const std::runtime_error& error)
+        {
+            std::cerr << "Skipping mesh cache: " << error.what() << std::endl;
+        }
+#else
+        catch (const std::runtime_error&) { }
+#endif
+
+        auto body = read_object_file(path).body;
+        body.prune();
+        body &= limit;
+        body.normalize();
+
+        try
+        {
+            write_mesh_cache(cache_path, body, limit, source_size, source_write_time);
+
+            return loaded_mesh{mapped_mesh{std::make_unique<mapped_file>(cache_path)}};
+        }
+#if !defined(NDEBUG)
+        catch (const std::runtime_error& error)
+        {
+            std::cerr << "Skipping mesh cache: " << error.what() << std::endl;
+        }
+#else
+        catch (const std::runtime_error&) { }
+#endif
+
+        return loaded_mesh{std::move(body)};
+    }
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include "not_implemented_error.hpp"
 #include "semantic_key.hpp"
 #include "tracked_pointer.hpp"
+#include "thread_pool.hpp"
 #include "sfinae_macros.hpp"
 
 
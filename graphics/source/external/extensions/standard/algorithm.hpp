@@ -25,6 +25,20 @@ namespace il
     }
 
 
+    // 64-bit FNV-1a. Unlike std::hash it is the same on every run and platform, so it can identify contents
+    // that are stored. Hashes of consecutive pieces chain by passing the previous one as the seed.
+    [[nodiscard, maybe_unused]] inline std::uint64_t hash_bytes(
+            const void* data,
+            const size_t size,
+            std::uint64_t seed = 14695981039346656037ull) noexcept
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0 ; i < size ; ++i) seed = (seed ^ bytes[i]) * 1099511628211ull;
+
+        return seed;
+    }
+
+
     template<typename ScalarType, std::enable_if_t<std::is_arithmetic_v<ScalarType>, int> = 0>
     [[nodiscard, maybe_unused]] size_t highest_bit_position(ScalarType scalar)
     {
@@ -0,0 +1,230 @@
+#ifndef IRGLAB_THREAD_POOL_HPP
+#define IRGLAB_THREAD_POOL_HPP
+
+
+#include "external/pch.hpp"
+
+
+namespace il
+{
+    // How whole-container operations should run. Automatic stays on the calling thread for inputs that are too
+    // small to amortize waking up the pool.
+    enum class [[maybe_unused]] execution_policy
+    {
+        sequential,
+        parallel,
+        automatic
+    };
+
+
+    // Fixed set of worker threads that run batches of indexed tasks. The thread submitting a batch works on it
+    // too, so batches submitted from inside a task can't deadlock even when all workers are busy.
+    class [[maybe_unused]] thread_pool
+    {
+    public:
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] explicit thread_pool(
+                const size_t worker_count = std::max(std::thread::hardware_concurrency(), 1u) - 1)
+        {
+            _workers.reserve(worker_count);
+            for (size_t i = 0 ; i < worker_count ; ++i) _workers.emplace_back([this]() { _work(); });
+
+#if !defined(NDEBUG)
+            std::cout << "Thread pool with " << worker_count << " workers created" << std::endl;
+#endif
+        }
+
+        [[maybe_unused]] ~thread_pool()
+        {
+            {
+                std::lock_guard lock{_mutex};
+                _is_stopping = true;
+            }
+            _work_available.notify_all();
+
+            for (auto& worker : _workers) worker.join();
+        }
+
+        thread_pool(thread_pool&) = delete;
+        thread_pool(thread_pool&&) = delete;
+        thread_pool& operator=(thread_pool&) = delete;
+        thread_pool& operator=(thread_pool&&) = delete;
+
+
+        // Shared by all geometry operations, created on first use.
+        [[nodiscard, maybe_unused]] static thread_pool& get_shared()
+        {
+            static thread_pool shared{ };
+            return shared;
+        }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] size_t thread_count() const noexcept
+        {
+            return _workers.size() + 1;
+        }
+
+
+        // Modifiers
+
+        // Runs function(i) for every i in [0, task_count) and returns when all of them finished. The first
+        // exception thrown by a task is rethrown here.
+        template<typename Function>
+        [[maybe_unused]] void run(const size_t task_count, const Function& function)
+        {
+            if (task_count == 0) return;
+
+            if (task_count == 1 || _workers.empty())
+            {
+                for (size_t i = 0 ; i < task_count ; ++i) function(i);
+                return;
+            }
+
+            _batch batch{task_count, [&function](const size_t i) { function(i); }};
+
+            {
+                std::lock_guard lock{_mutex};
+                _batches.emplace_back(&batch);
+            }
+            _work_available.notify_all();
+
+            while (_run_next_task(batch));
+
+            std::unique_lock lock{_mutex};
+            _batch_finished.wait(
+                    lock, [&batch]()
+                    {
+                        return batch.finished_count == batch.task_count && batch.worker_count == 0;
+                    });
+            _remove(batch);
+
+            if (batch.error) std::rethrow_exception(batch.error);
+        }
+
+
+        // Implementation details
+
+    private:
+        struct _batch
+        {
+            const size_t task_count;
+            const std::function<void(size_t)> function;
+
+            std::atomic<size_t> next_task{0};
+
+            // Guarded by the pool mutex. The batch lives on the stack of the submitting thread, which waits
+            // until no worker references it anymore.
+            size_t finished_count{0};
+            size_t worker_count{0};
+            std::exception_ptr error{ };
+        };
+
+
+        void _work()
+        {
+            std::unique_lock lock{_mutex};
+
+            while (true)
+            {
+                _work_available.wait(lock, [this]() { return _is_stopping || !_batches.empty(); });
+                if (_is_stopping) return;
+
+                auto& batch = *_batches.front();
+                ++batch.worker_count;
+
+                lock.unlock();
+                while (_run_next_task(batch));
+                lock.lock();
+
+                // Out of tasks, so make room for the next batch. The submitting thread removes it as well,
+                // whichever comes first.
+                _remove(batch);
+                if (--batch.worker_count == 0) _batch_finished.notify_all();
+            }
+        }
+
+        // Returns false if there was no task left to start.
+        bool _run_next_task(_batch& batch)
+        {
+            const auto task = batch.next_task.fetch_add(1);
+            if (task >= batch.task_count) return false;
+
+            std::exception_ptr error{ };
+            try
+            {
+                batch.function(task);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            bool is_last{false};
+            {
+                std::lock_guard lock{_mutex};
+
+                if (error && !batch.error) batch.error = error;
+                is_last = ++batch.finished_count == batch.task_count;
+            }
+            if (is_last) _batch_finished.notify_all();
+
+            return true;
+        }
+
+        // Must be called with the mutex held.
+        void _remove(const _batch& batch)
+        {
+            const auto position = std::find(_batches.begin(), _batches.end(), &batch);
+            if (position != _batches.end()) _batches.erase(position);
+        }
+
+
+        // Data
+
+        std::vector<std::thread> _workers{ };
+
+        std::mutex _mutex{ };
+        std::condition_variable _work_available{ };
+        std::condition_variable _batch_finished{ };
+
+        std::deque<_batch*> _batches{ };
+        bool _is_stopping{false};
+    };
+
+
+    // Runs function(i) for every i in [0, task_count) on the shared pool.
+    template<typename Function>
+    [[maybe_unused]] void run_parallel(const size_t task_count, const Function& function)
+    {
+        thread_pool::get_shared().run(task_count, function);
+    }
+
+    // Splits [0, count) into contiguous ranges of range_size elements, the last one possibly shorter, and runs
+    // function(begin, end) for each of them. Range boundaries don't depend on the number of threads, so
+    // operations that combine per range results give the same answer on every machine. With the automatic
+    // policy inputs of less than two ranges run on the calling thread.
+    template<typename Function>
+    [[maybe_unused]] void parallel_for_ranges(
+            const execution_policy policy, const size_t count, const size_t range_size, const Function& function)
+    {
+        const auto checked_range_size = std::max(range_size, static_cast<size_t>(1));
+
+        if (policy == execution_policy::sequential ||
+            (policy == execution_policy::automatic && count < 2 * checked_range_size))
+        {
+            function(static_cast<size_t>(0), count);
+            return;
+        }
+
+        run_parallel(
+                (count + checked_range_size - 1) / checked_range_size, [&](const size_t i)
+                {
+                    function(i * checked_range_size, std::min(count, (i + 1) * checked_range_size));
+                });
+    }
+}
+
+#endif
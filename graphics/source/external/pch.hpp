@@ -14,24 +14,31 @@
 #include <optional>
 #include <type_traits>
 #include <utility>
+#include <memory>
 #include <any>
 #include <variant>
 
 // Streams, IO, strings
 #include <fstream>
+#include <filesystem>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <cctype>
+#include <cstring>
 #include <regex>
+#include <charconv>
 
 // UINT32_MAX and UINT64 needed
 #include <cstdint>
+#include <limits>
 
 // STL and algorithms
 #include <algorithm>
+#include <numeric>
 #include <vector>
 #include <array>
+#include <deque>
 #include <unordered_set>
 #include <map>
 #include <set>
@@ -39,6 +46,15 @@
 // Threading
 #include <chrono>
 #include <thread>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// SIMD intrinsics
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
 
 
 
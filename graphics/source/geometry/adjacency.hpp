@@ -0,0 +1,384 @@
+#ifndef IRGLAB_ADJACENCY_HPP
+#define IRGLAB_ADJACENCY_HPP
+
+
+#include "external/external.hpp"
+
+#include "primitive/primitive.hpp"
+
+
+namespace il
+{
+    // Declarations
+
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] indexed_body;
+
+
+    // Index types
+
+    using face_index [[maybe_unused]] = std::uint32_t;
+    using half_edge_index [[maybe_unused]] = std::uint32_t;
+    using edge_index [[maybe_unused]] = std::uint32_t;
+
+    // Marks a missing face, half-edge or edge, like the other side of a boundary edge.
+    [[maybe_unused]] inline constexpr std::uint32_t no_index = UINT32_MAX;
+
+
+    // Non-owning view of a contiguous run of indices.
+    template<typename Index>
+    class [[maybe_unused]] index_span
+    {
+    public:
+        [[nodiscard, maybe_unused]] constexpr index_span(const Index* begin, const Index* end) noexcept :
+                _begin{begin}, _end{end}
+        { }
+
+
+        [[nodiscard, maybe_unused]] constexpr const Index* begin() const noexcept
+        {
+            return _begin;
+        }
+
+        [[nodiscard, maybe_unused]] constexpr const Index* end() const noexcept
+        {
+            return _end;
+        }
+
+        [[nodiscard, maybe_unused]] constexpr size_t size() const noexcept
+        {
+            return static_cast<size_t>(_end - _begin);
+        }
+
+        [[nodiscard, maybe_unused]] constexpr const Index& operator[](const size_t index) const noexcept
+        {
+            return _begin[index];
+        }
+
+
+    private:
+        const Index* _begin;
+        const Index* _end;
+    };
+
+
+
+    // Connectivity of a triangle mesh in flat arrays.
+    //
+    // Half-edge h belongs to face h / 3 and runs from corner h % 3 to the next corner of that face, so faces,
+    // next and origin need no storage beyond a copy of the triangles. Vertex to face incidence and edge to
+    // half-edge incidence are kept in compressed sparse row form: the faces around vertex v are
+    // _vertex_faces[_vertex_face_offsets[v] .. _vertex_face_offsets[v + 1]) and likewise for edges.
+    //
+    // Edges are undirected, so half-edges of neighbouring faces wound inconsistently, which object files often
+    // have, still share their edge and are twins. Whether twins run opposite ways is reported separately, as is
+    // an edge shared by more than two faces. Half-edges of such an edge are paired up as far as they go, opposite
+    // ones first; get_edge_half_edges lists all of them.
+    //
+    // Building is a counting sort over the corners followed by passes over the half-edges, so it is linear in
+    // the size of the mesh for bounded vertex valence.
+    class [[maybe_unused]] mesh_adjacency
+    {
+        // Traits and types
+
+    public:
+        using face_neighbours [[maybe_unused]] = std::array<face_index, 3>;
+        using edge_faces [[maybe_unused]] = std::array<face_index, 2>;
+        using edge_vertices [[maybe_unused]] = std::array<vertex_index, 2>;
+
+
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] mesh_adjacency() = default;
+
+        [[nodiscard, maybe_unused]] explicit mesh_adjacency(
+                const std::vector<triangle_indices>& triangles, const size_t vertex_count) :
+                _triangles{triangles}
+        {
+            if (triangles.size() * 3 >= no_index)
+            {
+                throw std::length_error("Mesh has too many half-edges for the adjacency index range.");
+            }
+
+            for (const auto& indices : triangles)
+            {
+                for (const auto index : indices)
+                {
+                    if (index >= vertex_count)
+                    {
+                        throw std::out_of_range("Triangle references a vertex that is not in the mesh.");
+                    }
+                }
+            }
+
+            _build_vertex_faces(vertex_count);
+            _build_edges();
+            _build_twins();
+        }
+
+        template<small_natural_number DimensionCount>
+        [[nodiscard, maybe_unused]] explicit mesh_adjacency(const indexed_body<DimensionCount>& body) :
+                mesh_adjacency{body.triangles(), body.vertex_count()}
+        { }
+
+
+        // Vertices
+
+        [[nodiscard, maybe_unused]] size_t vertex_count() const noexcept
+        {
+            return _vertex_face_offsets.empty() ? 0 : _vertex_face_offsets.size() - 1;
+        }
+
+        [[nodiscard, maybe_unused]] index_span<face_index> get_vertex_faces(const vertex_index vertex) const noexcept
+        {
+            return
+                    {
+                            _vertex_faces.data() + _vertex_face_offsets[vertex],
+                            _vertex_faces.data() + _vertex_face_offsets[vertex + 1]
+                    };
+        }
+
+
+        // Faces
+
+        [[nodiscard, maybe_unused]] size_t face_count() const noexcept
+        {
+            return _twins.size() / 3;
+        }
+
+        // Faces across each edge of the face, in corner order, or no_index across a boundary. Across a
+        // non-manifold edge this is one of the faces, or no_index if all of them were paired with others.
+        [[nodiscard, maybe_unused]] face_neighbours get_face_neighbours(const face_index face) const noexcept
+        {
+            face_neighbours result{ };
+            for (small_natural_number corner = 0 ; corner < 3 ; ++corner)
+            {
+                const auto twin = _twins[3 * face + corner];
+                result[corner] = twin == no_index ? no_index : get_face(twin);
+            }
+
+            return result;
+        }
+
+
+        // Half-edges
+
+        [[nodiscard, maybe_unused]] static constexpr face_index get_face(const half_edge_index half_edge) noexcept
+        {
+            return half_edge / 3;
+        }
+
+        [[nodiscard, maybe_unused]] static constexpr half_edge_index get_next(
+                const half_edge_index half_edge) noexcept
+        {
+            return half_edge - half_edge % 3 + (half_edge + 1) % 3;
+        }
+
+        [[nodiscard, maybe_unused]] vertex_index get_origin(const half_edge_index half_edge) const noexcept
+        {
+            return _triangles[half_edge / 3][half_edge % 3];
+        }
+
+        [[nodiscard, maybe_unused]] vertex_index get_destination(const half_edge_index half_edge) const noexcept
+        {
+            return get_origin(get_next(half_edge));
+        }
+
+        // The half-edge of the neighbouring face on the same edge, which runs the other way unless the faces are
+        // wound inconsistently.
+        [[nodiscard, maybe_unused]] half_edge_index get_twin(const half_edge_index half_edge) const noexcept
+        {
+            return _twins[half_edge];
+        }
+
+        // Also true on a boundary.
+        [[nodiscard, maybe_unused]] bool is_consistently_wound(const half_edge_index half_edge) const noexcept
+        {
+            const auto twin = _twins[half_edge];
+            return twin == no_index || get_origin(twin) == get_destination(half_edge);
+        }
+
+        [[nodiscard, maybe_unused]] edge_index get_edge(const half_edge_index half_edge) const noexcept
+        {
+            return _half_edge_edges[half_edge];
+        }
+
+
+        // Edges
+
+        [[nodiscard, maybe_unused]] size_t edge_count() const noexcept
+        {
+            return _edge_half_edge_offsets.empty() ? 0 : _edge_half_edge_offsets.size() - 1;
+        }
+
+        // Of all faces on the edge, one or two unless it is non-manifold.
+        [[nodiscard, maybe_unused]] index_span<half_edge_index> get_edge_half_edges(
+                const edge_index edge) const noexcept
+        {
+            return
+                    {
+                            _edge_half_edges.data() + _edge_half_edge_offsets[edge],
+                            _edge_half_edges.data() + _edge_half_edge_offsets[edge + 1]
+                    };
+        }
+
+        [[nodiscard, maybe_unused]] edge_vertices get_edge_vertices(const edge_index edge) const noexcept
+        {
+            const auto half_edge = get_edge_half_edges(edge)[0];
+            return {get_origin(half_edge), get_destination(half_edge)};
+        }
+
+        // The second face is no_index for boundary edges. Non-manifold edges have more faces than these two.
+        [[nodiscard, maybe_unused]] edge_faces get_edge_faces(const edge_index edge) const noexcept
+        {
+            const auto half_edges = get_edge_half_edges(edge);
+
+            return {get_face(half_edges[0]), half_edges.size() < 2 ? no_index : get_face(half_edges[1])};
+        }
+
+        [[nodiscard, maybe_unused]] bool is_edge_manifold(const edge_index edge) const noexcept
+        {
+            return get_edge_half_edges(edge).size() <= 2;
+        }
+
+        [[nodiscard, maybe_unused]] bool is_edge_consistently_wound(const edge_index edge) const noexcept
+        {
+            for (const auto half_edge : get_edge_half_edges(edge))
+                if (!is_consistently_wound(half_edge)) return false;
+
+            return true;
+        }
+
+
+        // Mesh
+
+        // Edges shared by more than two faces.
+        [[nodiscard, maybe_unused]] size_t non_manifold_edge_count() const noexcept
+        {
+            return _non_manifold_edge_count;
+        }
+
+        // Edges whose faces disagree on the winding, so at least one of them faces the other way.
+        [[nodiscard, maybe_unused]] size_t inconsistently_wound_edge_count() const noexcept
+        {
+            return _inconsistently_wound_edge_count;
+        }
+
+
+        // Implementation details
+
+    private:
+        void _build_vertex_faces(const size_t vertex_count)
+        {
+            _vertex_face_offsets.assign(vertex_count + 1, 0);
+            for (const auto& indices : _triangles)
+                for (const auto index : indices) ++_vertex_face_offsets[index + 1];
+
+            for (size_t i = 1 ; i < _vertex_face_offsets.size() ; ++i)
+                _vertex_face_offsets[i] += _vertex_face_offsets[i - 1];
+
+            // A degenerate triangle lists the same face twice for a vertex, which is harmless for queries.
+            _vertex_faces.resize(_triangles.size() * 3);
+            std::vector<std::uint32_t> cursors{_vertex_face_offsets.begin(), _vertex_face_offsets.end() - 1};
+            for (face_index face = 0 ; face < _triangles.size() ; ++face)
+                for (const auto index : _triangles[face]) _vertex_faces[cursors[index]++] = face;
+        }
+
+        // Groups the half-edges by their unordered pair of vertices.
+        void _build_edges()
+        {
+            const auto half_edge_count = static_cast<half_edge_index>(_triangles.size() * 3);
+
+            _half_edge_edges.assign(half_edge_count, no_index);
+            _edge_half_edges.clear();
+            _edge_half_edges.reserve(half_edge_count);
+            _edge_half_edge_offsets.assign(1, 0);
+            _non_manifold_edge_count = 0;
+
+            for (half_edge_index half_edge = 0 ; half_edge < half_edge_count ; ++half_edge)
+            {
+                if (_half_edge_edges[half_edge] != no_index) continue;
+
+                const auto edge = static_cast<edge_index>(edge_count());
+                const auto origin = get_origin(half_edge);
+                const auto destination = get_destination(half_edge);
+
+                // Every half-edge of the edge starts or ends at the origin, so it is in one of the faces around it.
+                for (const auto face : get_vertex_faces(origin))
+                {
+                    for (small_natural_number corner = 0 ; corner < 3 ; ++corner)
+                    {
+                        const auto candidate = static_cast<half_edge_index>(3 * face + corner);
+                        if (_half_edge_edges[candidate] != no_index) continue;
+
+                        const auto candidate_origin = get_origin(candidate);
+                        const auto candidate_destination = get_destination(candidate);
+                        if ((candidate_origin == origin && candidate_destination == destination) ||
+                            (candidate_origin == destination && candidate_destination == origin))
+                        {
+                            _half_edge_edges[candidate] = edge;
+                            _edge_half_edges.emplace_back(candidate);
+                        }
+                    }
+                }
+
+                _edge_half_edge_offsets.emplace_back(static_cast<std::uint32_t>(_edge_half_edges.size()));
+                if (!is_edge_manifold(edge)) ++_non_manifold_edge_count;
+            }
+        }
+
+        // Pairs the half-edges of each edge, opposite ones first so that a non-manifold edge keeps as many
+        // consistently wound pairs as it has.
+        void _build_twins()
+        {
+            _twins.assign(_triangles.size() * 3, no_index);
+            _inconsistently_wound_edge_count = 0;
+
+            for (edge_index edge = 0 ; edge < edge_count() ; ++edge)
+            {
+                const auto half_edges = get_edge_half_edges(edge);
+
+                for (const auto is_opposite_required : {true, false})
+                {
+                    for (size_t i = 0 ; i < half_edges.size() ; ++i)
+                    {
+                        if (_twins[half_edges[i]] != no_index) continue;
+
+                        for (size_t j = i + 1 ; j < half_edges.size() ; ++j)
+                        {
+                            if (_twins[half_edges[j]] != no_index ||
+                                (is_opposite_required &&
+                                 get_origin(half_edges[j]) != get_destination(half_edges[i])))
+                                continue;
+
+                            _twins[half_edges[i]] = half_edges[j];
+                            _twins[half_edges[j]] = half_edges[i];
+                            break;
+                        }
+                    }
+                }
+
+                if (!is_edge_consistently_wound(edge)) ++_inconsistently_wound_edge_count;
+            }
+        }
+
+
+        // Data
+
+        std::vector<triangle_indices> _triangles{ };
+
+        std::vector<std::uint32_t> _vertex_face_offsets{ };
+        std::vector<face_index> _vertex_faces{ };
+
+        std::vector<half_edge_index> _twins{ };
+
+        std::vector<edge_index> _half_edge_edges{ };
+        std::vector<std::uint32_t> _edge_half_edge_offsets{ };
+        std::vector<half_edge_index> _edge_half_edges{ };
+
+        size_t _non_manifold_edge_count{ };
+        size_t _inconsistently_wound_edge_count{ };
+    };
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef IRGLAB_BACK_FACE_CULLING_HPP
+#define IRGLAB_BACK_FACE_CULLING_HPP
+
+
+#include "external/external.hpp"
+
+#include "primitive/primitive.hpp"
+
+#include "adjacency.hpp"
+
+
+namespace il
+{
+    // Declarations
+
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] indexed_body;
+
+
+
+    // Finds the triangles facing a viewpoint, which are the ones whose normal points to the viewpoint side of
+    // their centroid. Normals and centroids are folded into one plane per triangle when they change, so culling
+    // is a single plane test per triangle over flat arrays and writes into a buffer sized once, without
+    // allocating.
+    class [[maybe_unused]] back_face_culling
+    {
+        // Traits and types
+
+    public:
+        [[maybe_unused]] static constexpr small_natural_number coefficient_count = d3::dimension_count + small_one;
+
+
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] back_face_culling() = default;
+
+        [[nodiscard, maybe_unused]] explicit back_face_culling(
+                const std::vector<d3::plane_normal>& normals, const std::vector<d3::cartesian_coordinates>& centroids)
+        {
+            update(normals, centroids);
+        }
+
+        template<small_natural_number DimensionCount>
+        [[nodiscard, maybe_unused]] explicit back_face_culling(const indexed_body<DimensionCount>& body)
+        {
+            update(body);
+        }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] size_t triangle_count() const noexcept
+        {
+            return _visible.size();
+        }
+
+
+        // Modifiers
+
+        [[maybe_unused]] void update(
+                const std::vector<d3::plane_normal>& normals, const std::vector<d3::cartesian_coordinates>& centroids)
+        {
+            if (normals.size() != centroids.size())
+            {
+                throw std::invalid_argument("Face normal and centroid counts differ.");
+            }
+
+            if (normals.size() >= no_index)
+            {
+                throw std::length_error("Too many triangles to cull.");
+            }
+
+            for (auto& coefficients : _coefficients) coefficients.resize(normals.size());
+            _visible.resize(normals.size());
+
+            for (size_t i = 0 ; i < normals.size() ; ++i)
+            {
+                for (small_natural_number k = 0 ; k < d3::dimension_count ; ++k)
+                    _coefficients[k][i] = normals[i][k];
+
+                _coefficients[d3::dimension_count][i] = -dot(normals[i], centroids[i]);
+            }
+        }
+
+        // Takes normals and centroids from the current vertex positions of the body.
+        template<small_natural_number DimensionCount>
+        [[maybe_unused]] void update(const indexed_body<DimensionCount>& body)
+        {
+            std::vector<d3::plane_normal> normals{ };
+            std::vector<d3::cartesian_coordinates> centroids{ };
+            normals.reserve(body.triangle_count());
+            centroids.reserve(body.triangle_count());
+
+            for (const auto& indices : body.triangles())
+            {
+                const auto first = d3::to_cartesian_coordinates(body.get_point(indices[0]));
+                const auto second = d3::to_cartesian_coordinates(body.get_point(indices[1]));
+                const auto third = d3::to_cartesian_coordinates(body.get_point(indices[2]));
+
+                normals.emplace_back(d3::get_plane_normal(first, second, third));
+                centroids.emplace_back((first + second + third) / 3.0f);
+            }
+
+            update(normals, centroids);
+        }
+
+
+        // Returns the triangles facing the viewpoint in increasing order. The span stays valid until the next
+        // cull or update.
+        [[nodiscard, maybe_unused]] index_span<face_index> cull(const d3::cartesian_coordinates& viewpoint) noexcept
+        {
+            d3::point_kernels::const_spans planes{ };
+            for (small_natural_number k = 0 ; k < coefficient_count ; ++k) planes[k] = _coefficients[k].data();
+
+            const auto visible_count = d3::point_kernels::select_above(
+                    planes, _visible.size(), viewpoint, _visible.data());
+
+            return index_span<face_index>{_visible.data(), _visible.data() + visible_count};
+        }
+
+
+        // Data
+
+    private:
+        std::array<std::vector<rational_number>, coefficient_count> _coefficients{ };
+        std::vector<face_index> _visible{ };
+    };
+}
+
+#endif
@@ -0,0 +1,708 @@
+#ifndef IRGLAB_BOUNDING_VOLUME_HIERARCHY_HPP
+#define IRGLAB_BOUNDING_VOLUME_HIERARCHY_HPP
+
+
+#include "external/external.hpp"
+
+#include "primitive/primitive.hpp"
+
+#include "indexed_body.hpp"
+
+
+namespace il
+{
+    // Query types
+
+    struct [[maybe_unused]] ray
+    {
+        d3::cartesian_coordinates origin;
+        d3::cartesian_coordinates direction;
+
+        rational_number max_distance{rational_number_max};
+    };
+
+    // Distance is measured in lengths of the ray direction. The hit point is
+    // (1 - u - v) * first + u * second + v * third of the hit triangle.
+    struct [[maybe_unused]] ray_hit
+    {
+        face_index triangle;
+        rational_number distance;
+
+        rational_number u;
+        rational_number v;
+    };
+
+
+
+    // Hierarchy of boxes over the triangles of a 3D indexed body.
+    //
+    // Nodes are 32 bytes, two to a cache line, and stored depth first: the left child of an inner node directly
+    // follows it and the right child index is stored in the node. Leaves store a range of an array of triangle
+    // indices instead, so a million triangle body takes about 20 MB in two flat arrays.
+    //
+    // The build bins triangle centroids along each axis and splits where the surface area heuristic is lowest.
+    // Large nodes bin in parallel and build their two subtrees in parallel; the layout only depends on the body,
+    // never on thread timing.
+    //
+    // The hierarchy doesn't keep a reference to the body. Queries take it as an argument and it must be the body
+    // the hierarchy was built or refit for.
+    class [[maybe_unused]] bounding_volume_hierarchy
+    {
+        // Traits and types
+
+    public:
+        struct alignas(32) node
+        {
+            std::array<rational_number, 3> minimum;
+            // Index of the right child for inner nodes, offset into the triangle array for leaves.
+            std::uint32_t first;
+
+            std::array<rational_number, 3> maximum;
+            // Zero for inner nodes.
+            std::uint32_t count;
+
+
+            [[nodiscard, maybe_unused]] bool is_leaf() const noexcept
+            {
+                return count > 0;
+            }
+        };
+
+        static_assert(sizeof(node) == 32);
+
+
+        [[maybe_unused]] static constexpr size_t max_leaf_size = 4;
+        [[maybe_unused]] static constexpr size_t bin_count = 16;
+
+        // Nodes with fewer triangles are built on a single thread into the array of their parent, with either
+        // policy. Forking below this would cost a task and an array per node.
+        [[maybe_unused]] static constexpr size_t parallel_build_threshold = 1 << 14;
+
+
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] bounding_volume_hierarchy() = default;
+
+        [[nodiscard, maybe_unused]] explicit bounding_volume_hierarchy(
+                const d3::indexed_body& body, const execution_policy policy = execution_policy::automatic)
+        {
+            if (body.triangle_count() >= no_index)
+            {
+                throw std::length_error("Body has too many triangles for a bounding volume hierarchy.");
+            }
+
+            if (body.triangle_count() == 0) return;
+
+            _build_context context{body, policy};
+            _triangles.resize(body.triangle_count());
+            std::iota(_triangles.begin(), _triangles.end(), 0);
+
+            parallel_for_ranges(
+                    policy, body.triangle_count(), d3::indexed_body::parallel_range_size,
+                    [&context, &body](const size_t begin, const size_t end)
+                    {
+                        for (auto i = begin ; i < end ; ++i)
+                        {
+                            context.boxes[i] = _get_triangle_box(body, static_cast<face_index>(i));
+                            context.centroids[i] = _get_center(context.boxes[i]);
+                        }
+                    });
+
+            _nodes = _build(context, 0, static_cast<std::uint32_t>(body.triangle_count()), 0);
+
+#if !defined(NDEBUG)
+            std::cout << "Bounding volume hierarchy with " << _nodes.size() << " nodes created" << std::endl;
+#endif
+        }
+
+
+        // Recomputes all boxes for moved vertices of the same body, keeping the tree structure. Much faster than
+        // a rebuild, but queries get slower the more the body deforms since it was built.
+        [[maybe_unused]] void refit(
+                const d3::indexed_body& body, const execution_policy policy = execution_policy::automatic)
+        {
+            if (body.triangle_count() != _triangles.size())
+            {
+                throw std::invalid_argument("Refit body has a different number of triangles than the hierarchy.");
+            }
+
+            parallel_for_ranges(
+                    policy, _nodes.size(), d3::indexed_body::parallel_range_size,
+                    [this, &body](const size_t begin, const size_t end)
+                    {
+                        for (auto i = begin ; i < end ; ++i)
+                        {
+                            auto& current = _nodes[i];
+                            if (!current.is_leaf()) continue;
+
+                            d3::aabb box{ };
+                            for (auto j = current.first ; j < current.first + current.count ; ++j)
+                                box |= _get_triangle_box(body, _triangles[j]);
+
+                            _set_box(current, box);
+                        }
+                    });
+
+            // Children always come after their parent.
+            for (auto i = _nodes.size() ; i-- > 0 ;)
+            {
+                auto& current = _nodes[i];
+                if (current.is_leaf()) continue;
+
+                _set_box(current, _get_box(_nodes[i + 1]) | _get_box(_nodes[current.first]));
+            }
+        }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] const std::vector<node>& nodes() const noexcept
+        {
+            return _nodes;
+        }
+
+        [[nodiscard, maybe_unused]] const std::vector<face_index>& triangles() const noexcept
+        {
+            return _triangles;
+        }
+
+        [[nodiscard, maybe_unused]] d3::aabb get_bounds() const noexcept
+        {
+            return _nodes.empty() ? d3::aabb{ } : _get_box(_nodes.front());
+        }
+
+
+        // Queries
+
+        // Closest triangle hit by the ray, if any. Back faces are hit too.
+        [[nodiscard, maybe_unused]] std::optional<ray_hit> intersect(
+                const d3::indexed_body& body, const ray& ray) const
+        {
+            std::optional<ray_hit> result{ };
+            auto max_distance = ray.max_distance;
+
+            const d3::cartesian_coordinates inverse_direction
+                    {
+                            rational_one / ray.direction.x,
+                            rational_one / ray.direction.y,
+                            rational_one / ray.direction.z
+                    };
+
+            _traverse(
+                    [&](const node& current)
+                    {
+                        return _intersects(current, ray.origin, inverse_direction, max_distance);
+                    },
+                    [&](const face_index triangle)
+                    {
+                        const auto hit = _intersect(body, triangle, ray);
+                        if (hit && hit->distance < max_distance)
+                        {
+                            max_distance = hit->distance;
+                            result = hit;
+                        }
+                    });
+
+            return result;
+        }
+
+        // Calls function(triangle) for every triangle whose box contains the point.
+        template<typename Function>
+        [[maybe_unused]] void for_each_containing(
+                const d3::indexed_body& body, const d3::point& point, const Function& function) const
+        {
+            _traverse(
+                    [&point](const node& current)
+                    {
+                        return _get_box(current).contains(point);
+                    },
+                    [&body, &point, &function](const face_index triangle)
+                    {
+                        if (_get_triangle_box(body, triangle).contains(point)) function(triangle);
+                    });
+        }
+
+        // Calls function(triangle) for every triangle whose box overlaps the given one.
+        template<typename Function>
+        [[maybe_unused]] void for_each_overlapping(
+                const d3::indexed_body& body, const d3::aabb& box, const Function& function) const
+        {
+            _traverse(
+                    [&box](const node& current)
+                    {
+                        return _get_box(current).intersects(box);
+                    },
+                    [&body, &box, &function](const face_index triangle)
+                    {
+                        if (_get_triangle_box(body, triangle).intersects(box)) function(triangle);
+                    });
+        }
+
+        [[nodiscard, maybe_unused]] std::vector<face_index> get_overlapping(
+                const d3::indexed_body& body, const d3::aabb& box) const
+        {
+            std::vector<face_index> result{ };
+            for_each_overlapping(
+                    body, box, [&result](const face_index triangle) { result.emplace_back(triangle); });
+
+            return result;
+        }
+
+
+        // Implementation details
+
+    private:
+        // Deep enough for any tree the build produces, see _max_sah_depth.
+        static constexpr size_t _max_traversal_depth = 128;
+
+        // Beyond this depth nodes are split in half by count, which bounds the depth by this plus log2 of the
+        // triangle count even for the most lopsided inputs.
+        static constexpr size_t _max_sah_depth = 64;
+
+
+        struct _build_context
+        {
+            explicit _build_context(const d3::indexed_body& body, const execution_policy policy) :
+                    boxes(body.triangle_count()),
+                    centroids(body.triangle_count()),
+                    policy{policy}
+            { }
+
+            std::vector<d3::aabb> boxes;
+            std::vector<d3::cartesian_coordinates> centroids;
+            const execution_policy policy;
+        };
+
+        struct _bin
+        {
+            d3::aabb box{ };
+            std::uint32_t count{0};
+        };
+
+        using _bins = std::array<std::array<_bin, bin_count>, d3::dimension_count>;
+
+        struct _split
+        {
+            small_natural_number axis{0};
+            size_t bin{0};
+            rational_number cost{rational_number_max};
+        };
+
+
+        // Boxes
+
+        [[nodiscard]] static d3::aabb _get_triangle_box(const d3::indexed_body& body, const face_index triangle)
+        {
+            d3::aabb result{ };
+            for (const auto index : body.triangles()[triangle])
+            {
+                const auto point = d3::to_cartesian_coordinates(body.get_point(index));
+                result |= d3::point{point.x, point.y, point.z, rational_one};
+            }
+
+            return result;
+        }
+
+        [[nodiscard]] static d3::cartesian_coordinates _get_center(const d3::aabb& box) noexcept
+        {
+            return box.get_center();
+        }
+
+        [[nodiscard]] static d3::aabb _get_box(const node& node) noexcept
+        {
+            d3::aabb result{ };
+            for (small_natural_number k = 0 ; k < d3::dimension_count ; ++k)
+            {
+                result.minimum[k] = node.minimum[k];
+                result.maximum[k] = node.maximum[k];
+            }
+
+            return result;
+        }
+
+        static void _set_box(node& node, const d3::aabb& box) noexcept
+        {
+            for (small_natural_number k = 0 ; k < d3::dimension_count ; ++k)
+            {
+                node.minimum[k] = box.minimum[k];
+                node.maximum[k] = box.maximum[k];
+            }
+        }
+
+        [[nodiscard]] static rational_number _get_half_area(const d3::aabb& box) noexcept
+        {
+            if (box.is_empty()) return rational_zero;
+
+            const auto difference = box.get_difference();
+            return difference.x * difference.y + difference.y * difference.z + difference.z * difference.x;
+        }
+
+
+        // Build
+
+        // Returns the nodes of the subtree with child indices relative to its root.
+        [[nodiscard]] std::vector<node> _build(
+                const _build_context& context, const std::uint32_t begin, const std::uint32_t end,
+                const size_t depth)
+        {
+            const auto count = end - begin;
+            const bool is_parallel =
+                    context.policy != execution_policy::sequential && count >= parallel_build_threshold;
+
+            if (!is_parallel)
+            {
+                std::vector<node> result{ };
+                result.reserve(2 * count / max_leaf_size + 1);
+                _build_sequential(context, begin, end, depth, result);
+
+                return result;
+            }
+
+            d3::aabb box{ };
+            d3::aabb centroid_box{ };
+            _get_range_boxes(context, begin, end, box, centroid_box);
+
+            const auto middle = _partition(context, begin, end, depth, centroid_box);
+            if (middle == end)
+            {
+                std::vector<node> result{_make_leaf(begin, count, box)};
+                return result;
+            }
+
+            std::array<std::vector<node>, 2> children{ };
+            run_parallel(
+                    2, [&](const size_t i)
+                    {
+                        children[i] = i == 0 ?
+                                      _build(context, begin, middle, depth + 1) :
+                                      _build(context, middle, end, depth + 1);
+                    });
+
+            std::vector<node> result{ };
+            result.reserve(1 + children[0].size() + children[1].size());
+
+            result.emplace_back(_make_inner(static_cast<std::uint32_t>(1 + children[0].size()), box));
+            _append(result, children[0]);
+            _append(result, children[1]);
+
+            return result;
+        }
+
+        void _build_sequential(
+                const _build_context& context, const std::uint32_t begin, const std::uint32_t end,
+                const size_t depth, std::vector<node>& nodes)
+        {
+            d3::aabb box{ };
+            d3::aabb centroid_box{ };
+            _get_range_boxes(context, begin, end, box, centroid_box);
+
+            const auto middle = _partition(context, begin, end, depth, centroid_box);
+            if (middle == end)
+            {
+                nodes.emplace_back(_make_leaf(begin, end - begin, box));
+                return;
+            }
+
+            const auto index = nodes.size();
+            nodes.emplace_back(_make_inner(0, box));
+
+            _build_sequential(context, begin, middle, depth + 1, nodes);
+            nodes[index].first = static_cast<std::uint32_t>(nodes.size());
+            _build_sequential(context, middle, end, depth + 1, nodes);
+        }
+
+        static void _append(std::vector<node>& nodes, const std::vector<node>& subtree)
+        {
+            const auto offset = static_cast<std::uint32_t>(nodes.size());
+
+            for (auto current : subtree)
+            {
+                if (!current.is_leaf()) current.first += offset;
+                nodes.emplace_back(current);
+            }
+        }
+
+        [[nodiscard]] static node _make_leaf(
+                const std::uint32_t first, const std::uint32_t count, const d3::aabb& box) noexcept
+        {
+            node result{ };
+            _set_box(result, box);
+            result.first = first;
+            result.count = count;
+
+            return result;
+        }
+
+        [[nodiscard]] static node _make_inner(const std::uint32_t right, const d3::aabb& box) noexcept
+        {
+            return _make_leaf(right, 0, box);
+        }
+
+
+        void _get_range_boxes(
+                const _build_context& context, const std::uint32_t begin, const std::uint32_t end,
+                d3::aabb& box, d3::aabb& centroid_box) const
+        {
+            for (auto i = begin ; i < end ; ++i)
+            {
+                const auto triangle = _triangles[i];
+                const auto& centroid = context.centroids[triangle];
+
+                box |= context.boxes[triangle];
+                centroid_box |= d3::point{centroid.x, centroid.y, centroid.z, rational_one};
+            }
+        }
+
+        // Reorders the range so that the two children are [begin, middle) and [middle, end), or returns end
+        // if the range should be a leaf.
+        [[nodiscard]] std::uint32_t _partition(
+                const _build_context& context, const std::uint32_t begin, const std::uint32_t end,
+                const size_t depth, const d3::aabb& centroid_box)
+        {
+            const auto count = end - begin;
+            if (count <= max_leaf_size) return end;
+
+            const auto extent = centroid_box.get_difference();
+            const bool is_degenerate = extent.x <= rational_zero && extent.y <= rational_zero &&
+                                       extent.z <= rational_zero;
+
+            if (depth < _max_sah_depth && !is_degenerate)
+            {
+                const auto bins = _get_bins(context, begin, end, centroid_box);
+                const auto split = _find_split(bins, count);
+
+                if (split.cost < static_cast<rational_number>(count))
+                {
+                    const auto middle = std::partition(
+                            _triangles.begin() + begin, _triangles.begin() + end,
+                            [&](const face_index triangle)
+                            {
+                                return _get_bin(context.centroids[triangle], centroid_box, split.axis) <= split.bin;
+                            });
+
+                    return static_cast<std::uint32_t>(middle - _triangles.begin());
+                }
+
+                // Splitting doesn't pay off, so keep small ranges together.
+                if (count <= 2 * max_leaf_size) return end;
+            }
+
+            // Same centroid everywhere, too deep or a large range SAH won't split: halve by count.
+            const auto middle = begin + count / 2;
+            const auto axis = static_cast<small_natural_number>(
+                    extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2));
+
+            std::nth_element(
+                    _triangles.begin() + begin, _triangles.begin() + middle, _triangles.begin() + end,
+                    [&](const face_index first, const face_index second)
+                    {
+                        const auto first_centroid = context.centroids[first][axis];
+                        const auto second_centroid = context.centroids[second][axis];
+
+                        return first_centroid < second_centroid ||
+                               (first_centroid == second_centroid && first < second);
+                    });
+
+            return middle;
+        }
+
+        [[nodiscard]] static size_t _get_bin(
+                const d3::cartesian_coordinates& centroid, const d3::aabb& centroid_box,
+                const small_natural_number axis) noexcept
+        {
+            const auto extent = centroid_box.maximum[axis] - centroid_box.minimum[axis];
+            if (extent <= rational_zero) return 0;
+
+            const auto bin = static_cast<size_t>(
+                    (centroid[axis] - centroid_box.minimum[axis]) / extent * static_cast<rational_number>(bin_count));
+
+            return std::min(bin, bin_count - 1);
+        }
+
+        [[nodiscard]] _bins _get_bins(
+                const _build_context& context, const std::uint32_t begin, const std::uint32_t end,
+                const d3::aabb& centroid_box) const
+        {
+            const auto fill = [&](const size_t range_begin, const size_t range_end, _bins& bins)
+            {
+                for (auto i = range_begin ; i < range_end ; ++i)
+                {
+                    const auto triangle = _triangles[i];
+                    for (small_natural_number axis = 0 ; axis < d3::dimension_count ; ++axis)
+                    {
+                        auto& bin = bins[axis][_get_bin(context.centroids[triangle], centroid_box, axis)];
+                        bin.box |= context.boxes[triangle];
+                        ++bin.count;
+                    }
+                }
+            };
+
+            const auto count = static_cast<size_t>(end - begin);
+            const auto range_size = parallel_build_threshold / 4;
+
+            // Per range bins are merged in range order, so the result doesn't depend on the thread count.
+            std::vector<_bins> range_bins((count + range_size - 1) / range_size);
+            parallel_for_ranges(
+                    count < parallel_build_threshold ? execution_policy::sequential : context.policy,
+                    count, range_size, [&](const size_t range_begin, const size_t range_end)
+                    {
+                        fill(begin + range_begin, begin + range_end, range_bins[range_begin / range_size]);
+                    });
+
+            _bins result{ };
+            for (const auto& bins : range_bins)
+            {
+                for (small_natural_number axis = 0 ; axis < d3::dimension_count ; ++axis)
+                {
+                    for (size_t bin = 0 ; bin < bin_count ; ++bin)
+                    {
+                        result[axis][bin].box |= bins[axis][bin].box;
+                        result[axis][bin].count += bins[axis][bin].count;
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        // Cost is in units of triangle intersections, relative to the area of the node, with one traversal step
+        // costing as much as one intersection. Splitting after the returned bin is worth it if the cost is
+        // less than the triangle count.
+        [[nodiscard]] static _split _find_split(const _bins& bins, const size_t count) noexcept
+        {
+            _split result{ };
+
+            for (small_natural_number axis = 0 ; axis < d3::dimension_count ; ++axis)
+            {
+                std::array<rational_number, bin_count> right_costs{ };
+
+                d3::aabb right_box{ };
+                size_t right_count = 0;
+                for (auto bin = bin_count ; bin-- > 1 ;)
+                {
+                    right_box |= bins[axis][bin].box;
+                    right_count += bins[axis][bin].count;
+                    right_costs[bin] = _get_half_area(right_box) * static_cast<rational_number>(right_count);
+                }
+
+                d3::aabb left_box{ };
+                size_t left_count = 0;
+                for (size_t bin = 0 ; bin + 1 < bin_count ; ++bin)
+                {
+                    left_box |= bins[axis][bin].box;
+                    left_count += bins[axis][bin].count;
+                    if (left_count == 0 || left_count == count) continue;
+
+                    const auto cost =
+                            _get_half_area(left_box) * static_cast<rational_number>(left_count) +
+                            right_costs[bin + 1];
+
+                    if (cost < result.cost) result = _split{axis, bin, cost};
+                }
+            }
+
+            // Normalize by the area of the node itself.
+            d3::aabb box{ };
+            for (const auto& bin : bins[0]) box |= bin.box;
+
+            const auto area = _get_half_area(box);
+            result.cost = area > rational_zero ? rational_one + result.cost / area : rational_number_max;
+
+            return result;
+        }
+
+
+        // Queries
+
+        template<typename NodePredicate, typename TriangleFunction>
+        void _traverse(const NodePredicate& node_predicate, const TriangleFunction& triangle_function) const
+        {
+            if (_nodes.empty()) return;
+
+            std::array<std::uint32_t, _max_traversal_depth> stack{ };
+            size_t stack_size = 0;
+            stack[stack_size++] = 0;
+
+            while (stack_size > 0)
+            {
+                const auto& current = _nodes[stack[--stack_size]];
+                if (!node_predicate(current)) continue;
+
+                if (current.is_leaf())
+                {
+                    for (auto i = current.first ; i < current.first + current.count ; ++i)
+                        triangle_function(_triangles[i]);
+                }
+                else
+                {
+                    const auto index = static_cast<std::uint32_t>(&current - _nodes.data());
+                    stack[stack_size++] = current.first;
+                    stack[stack_size++] = index + 1;
+                }
+            }
+        }
+
+        [[nodiscard]] static bool _intersects(
+                const node& node,
+                const d3::cartesian_coordinates& origin,
+                const d3::cartesian_coordinates& inverse_direction,
+                const rational_number max_distance) noexcept
+        {
+            rational_number near = rational_zero;
+            rational_number far = max_distance;
+
+            for (small_natural_number k = 0 ; k < d3::dimension_count ; ++k)
+            {
+                const auto first = (node.minimum[k] - origin[k]) * inverse_direction[k];
+                const auto second = (node.maximum[k] - origin[k]) * inverse_direction[k];
+
+                near = std::max(near, std::min(first, second));
+                far = std::min(far, std::max(first, second));
+            }
+
+            return near <= far;
+        }
+
+        // Möller-Trumbore.
+        [[nodiscard]] static std::optional<ray_hit> _intersect(
+                const d3::indexed_body& body, const face_index triangle, const ray& ray)
+        {
+            static constexpr rational_number epsilon = 1e-8f;
+
+            const auto& indices = body.triangles()[triangle];
+            const auto first = d3::to_cartesian_coordinates(body.get_point(indices[0]));
+            const auto second = d3::to_cartesian_coordinates(body.get_point(indices[1]));
+            const auto third = d3::to_cartesian_coordinates(body.get_point(indices[2]));
+
+            const auto first_edge = second - first;
+            const auto second_edge = third - first;
+
+            const auto p = cross(ray.direction, second_edge);
+            const auto determinant = dot(first_edge, p);
+            if (std::abs(determinant) < epsilon) return std::nullopt;
+
+            const auto inverse_determinant = rational_one / determinant;
+            const auto to_origin = ray.origin - first;
+
+            const auto u = dot(to_origin, p) * inverse_determinant;
+            if (u < rational_zero || u > rational_one) return std::nullopt;
+
+            const auto q = cross(to_origin, first_edge);
+            const auto v = dot(ray.direction, q) * inverse_determinant;
+            if (v < rational_zero || u + v > rational_one) return std::nullopt;
+
+            const auto distance = dot(second_edge, q) * inverse_determinant;
+            if (distance < rational_zero) return std::nullopt;
+
+            return ray_hit{triangle, distance, u, v};
+        }
+
+
+        // Data
+
+        std::vector<node> _nodes{ };
+        std::vector<face_index> _triangles{ };
+    };
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef IRGLAB_FRUSTUM_HPP
+#define IRGLAB_FRUSTUM_HPP
+
+
+#include "external/external.hpp"
+
+#include "primitive/primitive.hpp"
+
+#include "half_spaces.hpp"
+
+
+namespace il
+{
+    // Part of view space that ends up on screen: in front of the near plane and within the projection of the
+    // screen rectangle. Works on homogeneous view space points, where all of its planes are linear, so
+    // clipping can interpolate before the perspective divide.
+    //
+    // Points are classified by outcodes with one bit per plane they are outside of. Triangles whose vertices
+    // share a bit are entirely outside and triangles without any bits are entirely inside.
+    class [[maybe_unused]] view_frustum
+    {
+        // Traits and types
+
+    public:
+        using outcode = std::uint8_t;
+
+        [[maybe_unused]] static constexpr outcode near_bit = 1 << 0;
+        [[maybe_unused]] static constexpr outcode left_bit = 1 << 1;
+        [[maybe_unused]] static constexpr outcode right_bit = 1 << 2;
+        [[maybe_unused]] static constexpr outcode bottom_bit = 1 << 3;
+        [[maybe_unused]] static constexpr outcode top_bit = 1 << 4;
+
+        [[maybe_unused]] static constexpr small_natural_number plane_count = 5;
+
+
+        // Constructors and related methods
+
+        // Projected x in [-aspect_ratio, aspect_ratio] and y in [-1, 1] are on screen, with projection as
+        // x * projection_plane_distance / z like the camera does it.
+        [[nodiscard, maybe_unused]] view_frustum(
+                const rational_number projection_plane_distance,
+                const rational_number aspect_ratio,
+                const rational_number near_distance) :
+                _planes
+                        {
+                                d3::plane{0.0f, 0.0f, 1.0f, -near_distance},
+                                d3::plane{projection_plane_distance, 0.0f, aspect_ratio, 0.0f},
+                                d3::plane{-projection_plane_distance, 0.0f, aspect_ratio, 0.0f},
+                                d3::plane{0.0f, projection_plane_distance, 1.0f, 0.0f},
+                                d3::plane{0.0f, -projection_plane_distance, 1.0f, 0.0f}
+                        },
+                _near_distance{near_distance}
+        {
+            if (!(projection_plane_distance > rational_zero) || !(aspect_ratio > rational_zero))
+            {
+                throw std::invalid_argument("Frustum needs a positive projection plane distance and aspect ratio.");
+            }
+        }
+
+        // Frustum of a screen of the given size, or nothing while it has no area, like when its window is
+        // minimized. Its aspect ratio would not be a number then, and there is nothing on screen to cull for.
+        [[nodiscard, maybe_unused]] static std::optional<view_frustum> for_extent(
+                const rational_number projection_plane_distance,
+                const std::uint32_t width,
+                const std::uint32_t height,
+                const rational_number near_distance)
+        {
+            if (width == 0 || height == 0) return std::nullopt;
+
+            return view_frustum
+                    {
+                            projection_plane_distance,
+                            static_cast<rational_number>(width) / static_cast<rational_number>(height),
+                            near_distance
+                    };
+        }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] rational_number near_distance() const noexcept
+        {
+            return _near_distance;
+        }
+
+
+        // Non-modifiers
+
+        [[nodiscard, maybe_unused]] outcode get_outcode(const d3::point& view_point) const noexcept
+        {
+            outcode result{0};
+            for (small_natural_number plane = 0 ; plane < plane_count ; ++plane)
+                result |= static_cast<outcode>((dot(_planes[plane], view_point) < rational_zero) << plane);
+
+            return result;
+        }
+
+        // Classifies a world space box through its corners in view space. Boxes that are outside of no single
+        // plane but still miss the frustum, like ones diagonally past a corner, count as boundary.
+        [[nodiscard, maybe_unused]] containment classify(
+                const d3::aabb& box, const d3::transformation& view_transformation) const noexcept
+        {
+            if (box.is_empty()) return containment::outside;
+
+            outcode all_corners{static_cast<outcode>((1 << plane_count) - 1)};
+            outcode any_corner{0};
+
+            for (small_natural_number corner = 0 ; corner < 8 ; ++corner)
+            {
+                const d3::point world_corner
+                        {
+                                corner & 1 ? box.maximum[0] : box.minimum[0],
+                                corner & 2 ? box.maximum[1] : box.minimum[1],
+                                corner & 4 ? box.maximum[2] : box.minimum[2],
+                                rational_one
+                        };
+
+                const auto code = get_outcode(world_corner * view_transformation);
+                all_corners &= code;
+                any_corner |= code;
+            }
+
+            if (all_corners != 0) return containment::outside;
+            return any_corner == 0 ? containment::inside : containment::boundary;
+        }
+
+
+        // Cuts the triangle at the near plane and calls emit(view_point, attribute) for the vertices of the
+        // resulting zero, one or two triangles, keeping the winding. Attributes are interpolated linearly in
+        // view space, so they need a + (b - a) * t.
+        template<typename Attribute, typename Emit>
+        [[maybe_unused]] void clip_to_near_plane(
+                const std::array<d3::point, 3>& view_points,
+                const std::array<Attribute, 3>& attributes,
+                const Emit& emit) const
+        {
+            std::array<d3::point, 4> clipped_points{ };
+            std::array<Attribute, 4> clipped_attributes{ };
+            small_natural_number clipped_count = 0;
+
+            for (small_natural_number current = 0 ; current < 3 ; ++current)
+            {
+                const auto next = static_cast<small_natural_number>((current + 1) % 3);
+
+                const auto current_distance = dot(_planes[0], view_points[current]);
+                const auto next_distance = dot(_planes[0], view_points[next]);
+
+                if (current_distance >= rational_zero)
+                {
+                    clipped_points[clipped_count] = view_points[current];
+                    clipped_attributes[clipped_count] = attributes[current];
+                    ++clipped_count;
+                }
+
+                if ((current_distance >= rational_zero) != (next_distance >= rational_zero))
+                {
+                    const auto t = current_distance / (current_distance - next_distance);
+
+                    clipped_points[clipped_count] =
+                            view_points[current] + (view_points[next] - view_points[current]) * t;
+                    clipped_attributes[clipped_count] =
+                            attributes[current] + (attributes[next] - attributes[current]) * t;
+                    ++clipped_count;
+                }
+            }
+
+            for (small_natural_number fan = 2 ; fan < clipped_count ; ++fan)
+            {
+                emit(clipped_points[0], clipped_attributes[0]);
+                emit(clipped_points[fan - 1], clipped_attributes[fan - 1]);
+                emit(clipped_points[fan], clipped_attributes[fan]);
+            }
+        }
+
+
+        // Data
+
+    private:
+        std::array<d3::plane, plane_count> _planes;
+        rational_number _near_distance;
+    };
+}
+
+#endif
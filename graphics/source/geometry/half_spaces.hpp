@@ -0,0 +1,171 @@
+#ifndef IRGLAB_HALF_SPACES_HPP
+#define IRGLAB_HALF_SPACES_HPP
+
+
+#include "external/external.hpp"
+
+#include "primitive/primitive.hpp"
+
+
+namespace il
+{
+    // Declarations
+
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] indexed_body;
+
+
+    // Where a point is relative to an intersection of half-spaces. Boundary covers points within the tolerance
+    // of a plane, which used to be an exception.
+    enum class [[maybe_unused]] containment : unsigned char
+    {
+        inside,
+        boundary,
+        outside
+    };
+
+
+
+    // Intersection of the half-spaces below the planes of a convex body's triangles, kept as one array per plane
+    // coefficient. Normals are scaled to unit length, so plane values are distances. Degenerate triangles have
+    // no plane and are left out.
+    class [[maybe_unused]] half_spaces
+    {
+        // Traits and types
+
+    public:
+        [[maybe_unused]] static constexpr small_natural_number coefficient_count = d3::dimension_count + small_one;
+
+        [[maybe_unused]] static constexpr rational_number default_tolerance = 1e-6f;
+
+        // Points classified per pass over the planes, whose distances fit on the stack.
+        [[maybe_unused]] static constexpr size_t classify_chunk_size = 256;
+
+
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] half_spaces() = default;
+
+        [[nodiscard, maybe_unused]] explicit half_spaces(
+                const d3::point_kernels::const_spans& points, const std::vector<triangle_indices>& triangles)
+        {
+            for (auto& coefficients : _coefficients) coefficients.reserve(triangles.size());
+
+            for (const auto& indices : triangles)
+            {
+                std::array<d3::cartesian_coordinates, 3> corners{ };
+                for (small_natural_number corner = 0 ; corner < 3 ; ++corner)
+                {
+                    const auto index = indices[corner];
+                    const auto homogeneous = points[d3::dimension_count][index];
+
+                    corners[corner] = d3::cartesian_coordinates
+                            {
+                                    points[0][index] / homogeneous,
+                                    points[1][index] / homogeneous,
+                                    points[2][index] / homogeneous
+                            };
+                }
+
+                const auto plane = d3::get_common_plane(corners[0], corners[1], corners[2]);
+                const auto normal_length = length(d3::cartesian_coordinates{plane.x, plane.y, plane.z});
+                if (!(normal_length > rational_zero)) continue;
+
+                for (small_natural_number k = 0 ; k < coefficient_count ; ++k)
+                    _coefficients[k].emplace_back(plane[k] / normal_length);
+            }
+        }
+
+        template<small_natural_number DimensionCount>
+        [[nodiscard, maybe_unused]] explicit half_spaces(const indexed_body<DimensionCount>& body) :
+                half_spaces{body.get_coordinate_spans(), body.triangles()}
+        { }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] size_t plane_count() const noexcept
+        {
+            return _coefficients[0].size();
+        }
+
+        [[nodiscard, maybe_unused]] d3::plane get_plane(const size_t index) const noexcept
+        {
+            return d3::plane
+                    {
+                            _coefficients[0][index],
+                            _coefficients[1][index],
+                            _coefficients[2][index],
+                            _coefficients[3][index]
+                    };
+        }
+
+
+        // Non-modifiers
+
+        [[nodiscard, maybe_unused]] containment classify(
+                const d3::point& point, const rational_number tolerance = default_tolerance) const noexcept
+        {
+            std::array<rational_number, coefficient_count> components{point.x, point.y, point.z, point.w};
+            d3::point_kernels::const_spans spans{ };
+            for (small_natural_number k = 0 ; k < coefficient_count ; ++k) spans[k] = &components[k];
+
+            rational_number distance;
+            d3::point_kernels::reduce_plane_distances(
+                    spans, 1, _get_spans(), plane_count(), tolerance, &distance);
+
+            return _classify(distance, tolerance);
+        }
+
+        // Classifies points given as one array per homogeneous component, all of which must be positive. Points
+        // are checked in groups of register width and a group stops at the first plane all of its points are
+        // outside of. Nothing is allocated, points go through in chunks of classify_chunk_size.
+        [[maybe_unused]] void classify(
+                const d3::point_kernels::const_spans& points, const size_t count, containment* results,
+                const rational_number tolerance = default_tolerance) const noexcept
+        {
+            std::array<rational_number, classify_chunk_size> distances;
+
+            for (size_t begin = 0 ; begin < count ; begin += classify_chunk_size)
+            {
+                const auto chunk_count = std::min(count - begin, classify_chunk_size);
+
+                auto chunk_points = points;
+                for (auto& span : chunk_points) span += begin;
+
+                d3::point_kernels::reduce_plane_distances(
+                        chunk_points, chunk_count, _get_spans(), plane_count(), tolerance, distances.data());
+
+                for (size_t i = 0 ; i < chunk_count ; ++i) results[begin + i] = _classify(distances[i], tolerance);
+            }
+        }
+
+
+        // Implementation details
+
+    private:
+        [[nodiscard]] static containment _classify(
+                const rational_number distance, const rational_number tolerance) noexcept
+        {
+            if (distance > tolerance) return containment::outside;
+            if (distance >= -tolerance) return containment::boundary;
+
+            return containment::inside;
+        }
+
+        [[nodiscard]] d3::point_kernels::const_spans _get_spans() const noexcept
+        {
+            d3::point_kernels::const_spans result{ };
+            for (small_natural_number k = 0 ; k < coefficient_count ; ++k) result[k] = _coefficients[k].data();
+
+            return result;
+        }
+
+
+        // Data
+
+        std::array<std::vector<rational_number>, coefficient_count> _coefficients{ };
+    };
+}
+
+#endif
@@ -0,0 +1,672 @@
+#ifndef IRGLAB_INDEXED_BODY_HPP
+#define IRGLAB_INDEXED_BODY_HPP
+
+
+#include "external/external.hpp"
+
+
+#include "primitive/primitive.hpp"
+
+#include "adjacency.hpp"
+#include "half_spaces.hpp"
+#include "triangle.hpp"
+#include "wireframe.hpp"
+
+
+namespace il
+{
+    // Type traits
+
+    [[nodiscard, maybe_unused]] constexpr bool is_indexed_body_description_supported(
+            small_natural_number dimension_count)
+    {
+        return are_primitive_operations_supported(dimension_count);
+    }
+
+
+    // Declarations
+
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] indexed_body;
+
+
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] convex_indexed_body;
+
+
+    // Dimensional aliases
+
+    namespace d2
+    {
+        using indexed_body [[maybe_unused]] = il::indexed_body<dimension_count>;
+        using convex_indexed_body [[maybe_unused]] = il::convex_indexed_body<dimension_count>;
+    }
+
+    namespace d3
+    {
+        using indexed_body [[maybe_unused]] = il::indexed_body<dimension_count>;
+        using convex_indexed_body [[maybe_unused]] = il::convex_indexed_body<dimension_count>;
+    }
+
+
+
+    // Implementation
+
+    // Vertices are kept as one contiguous array per homogeneous component (structure of arrays) and triangles
+    // as triples of indices into those arrays, so whole-body operations walk memory linearly instead of
+    // chasing a shared pointer per vertex and a hash node per triangle.
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] indexed_body
+    {
+        // Traits and types
+
+    public:
+        [[maybe_unused]] static constexpr small_natural_number dimension_count = DimensionCount;
+        [[maybe_unused]] static constexpr small_natural_number component_count = DimensionCount + small_one;
+
+        [[maybe_unused]] static constexpr small_natural_number triangle_vertex_count = 3;
+
+        // Vertices or triangles handed to one task when an operation runs in parallel. Bodies smaller than two
+        // ranges run on the calling thread with the automatic policy.
+        [[maybe_unused]] static constexpr size_t parallel_range_size = 1 << 14;
+
+
+        using point [[maybe_unused]] = il::point<dimension_count>;
+        using triangle [[maybe_unused]] = il::owning_triangle<dimension_count>;
+        using wireframe [[maybe_unused]] = il::owning_wireframe<dimension_count>;
+
+        using coordinates [[maybe_unused]] = std::vector<rational_number>;
+
+
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] indexed_body() = default;
+
+        ENABLE_IF_TEMPLATE(is_indexed_body_description_supported(dimension_count))
+        [[nodiscard, maybe_unused]] explicit indexed_body(
+                const std::initializer_list<point>& points,
+                const std::initializer_list<triangle_indices>& triangles)
+        {
+            _assign(points.begin(), points.end(), triangles.begin(), triangles.end());
+        }
+
+        template<
+                typename PointRange, typename TriangleRange, ENABLE_IF(
+                        (is_indexed_body_description_supported(DimensionCount) &&
+                         is_range<PointRange> && std::is_same_v<range_value_type<PointRange>, point> &&
+                         is_range<TriangleRange> &&
+                         std::is_same_v<range_value_type<TriangleRange>, triangle_indices>))>
+        [[nodiscard, maybe_unused]] explicit indexed_body(const PointRange& points, const TriangleRange& triangles)
+        {
+            _assign(points.begin(), points.end(), triangles.begin(), triangles.end());
+        }
+
+        // Takes over already laid out component arrays, which is what loaders produce.
+        ENABLE_IF_TEMPLATE(is_indexed_body_description_supported(dimension_count))
+        [[nodiscard, maybe_unused]] explicit indexed_body(
+                std::array<coordinates, component_count> component_arrays,
+                std::vector<triangle_indices> triangles) :
+                _coordinates{std::move(component_arrays)},
+                _triangles{std::move(triangles)}
+        {
+            for (const auto& component_coordinates : _coordinates)
+            {
+                if (component_coordinates.size() != vertex_count())
+                {
+                    throw std::invalid_argument("Indexed body coordinate arrays differ in length.");
+                }
+            }
+
+            if (vertex_count() > vertex_index_max)
+            {
+                throw std::length_error("Indexed body vertex count exceeds the vertex index range.");
+            }
+
+            for (const auto& indices : _triangles)
+            {
+                for (const auto index : indices)
+                {
+                    if (index >= vertex_count())
+                    {
+                        throw std::out_of_range("Triangle references a vertex that is not in the body.");
+                    }
+                }
+            }
+        }
+
+        // Also takes over unit vertex normals computed before, like by get_vertex_normals of the same body, which
+        // are then kept until vertices move or the topology changes.
+        ENABLE_IF_TEMPLATE(dimension_count == d3::dimension_count)
+        [[nodiscard, maybe_unused]] explicit indexed_body(
+                std::array<coordinates, component_count> component_arrays,
+                std::vector<triangle_indices> triangles,
+                std::vector<d3::plane_normal> vertex_normals) :
+                indexed_body{std::move(component_arrays), std::move(triangles)}
+        {
+            if (vertex_normals.size() != vertex_count())
+            {
+                throw std::invalid_argument("Indexed body vertex normals differ in count from its vertices.");
+            }
+
+            _vertex_normals = std::move(vertex_normals);
+            _are_vertex_normals_dirty = false;
+        }
+
+
+        [[maybe_unused]] void reserve(const size_t vertex_count, const size_t triangle_count)
+        {
+            for (auto& coordinates : _coordinates) coordinates.reserve(vertex_count);
+            _triangles.reserve(triangle_count);
+        }
+
+        // Removes triangles that reference the same vertex more than once and vertices that no triangle
+        // references, then compacts the coordinate arrays.
+        [[maybe_unused]] void prune()
+        {
+            _triangles.erase(
+                    std::remove_if(
+                            _triangles.begin(), _triangles.end(),
+                            [](const triangle_indices& indices)
+                            {
+                                return indices[0] == indices[1] ||
+                                       indices[1] == indices[2] ||
+                                       indices[2] == indices[0];
+                            }),
+                    _triangles.end());
+
+            std::vector<vertex_index> remapped_indices(vertex_count(), vertex_index_max);
+            for (const auto& indices : _triangles)
+                for (const auto index : indices) remapped_indices[index] = 0;
+
+            vertex_index new_vertex_count = 0;
+            for (size_t i = 0 ; i < remapped_indices.size() ; ++i)
+            {
+                if (remapped_indices[i] == vertex_index_max) continue;
+
+                for (auto& coordinates : _coordinates) coordinates[new_vertex_count] = coordinates[i];
+                remapped_indices[i] = new_vertex_count++;
+            }
+
+            for (auto& coordinates : _coordinates) coordinates.resize(new_vertex_count);
+            for (auto& indices : _triangles)
+                for (auto& index : indices) index = remapped_indices[index];
+
+            _invalidate_topology();
+        }
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] size_t vertex_count() const noexcept
+        {
+            return _coordinates[0].size();
+        }
+
+        [[nodiscard, maybe_unused]] size_t triangle_count() const noexcept
+        {
+            return _triangles.size();
+        }
+
+
+        [[nodiscard, maybe_unused]] const coordinates& coordinate(const small_natural_number component) const
+        {
+            return _coordinates.at(component);
+        }
+
+        // Input for point_kernels, valid until vertices are added.
+        [[nodiscard, maybe_unused]] typename point_kernels<dimension_count>::const_spans
+        get_coordinate_spans() const noexcept
+        {
+            typename point_kernels<dimension_count>::const_spans result{ };
+            for (small_natural_number component = 0 ; component < component_count ; ++component)
+                result[component] = _coordinates[component].data();
+
+            return result;
+        }
+
+        [[nodiscard, maybe_unused]] const std::vector<triangle_indices>& triangles() const noexcept
+        {
+            return _triangles;
+        }
+
+
+        [[nodiscard, maybe_unused]] point get_point(const vertex_index index) const
+        {
+            point result{ };
+            for (small_natural_number component = 0 ; component < component_count ; ++component)
+                result[component] = _coordinates[component][index];
+
+            return result;
+        }
+
+        // Built on first use and kept until triangles or vertices are added or removed.
+        [[nodiscard, maybe_unused]] const mesh_adjacency& get_adjacency() const
+        {
+            if (!_adjacency) _adjacency.emplace(*this);
+
+            return *_adjacency;
+        }
+
+
+        [[nodiscard, maybe_unused]] triangle get_triangle(const size_t triangle_index) const
+        {
+            const auto& indices = _triangles[triangle_index];
+
+            return triangle
+                    {
+                            get_point(indices[0]),
+                            get_point(indices[1]),
+                            get_point(indices[2])
+                    };
+        }
+
+
+        // Non-modifiers
+
+        // Computed on first use and cached until vertices move or are added. Every vertex is folded exactly
+        // once, no matter how many triangles share it.
+        [[nodiscard, maybe_unused]] const aabb<dimension_count>& get_aabb(
+                const execution_policy policy = execution_policy::automatic) const
+        {
+            if (_is_aabb_dirty)
+            {
+                std::vector<aabb<dimension_count>> range_boxes(
+                        std::max((vertex_count() + parallel_range_size - 1) / parallel_range_size, size_t{1}));
+
+                const auto spans = get_coordinate_spans();
+                parallel_for_ranges(
+                        policy, vertex_count(), parallel_range_size, [&spans, &range_boxes](
+                                const size_t begin, const size_t end)
+                        {
+                            point_kernels<dimension_count>::reduce_bounds(
+                                    _offset(spans, begin), end - begin, range_boxes[begin / parallel_range_size]);
+                        });
+
+                _aabb = aabb<dimension_count>{ };
+                for (const auto& box : range_boxes) _aabb |= box;
+
+                _is_aabb_dirty = false;
+            }
+
+            return _aabb;
+        }
+
+        [[nodiscard, maybe_unused]] bounds<dimension_count> get_bounds(
+                const execution_policy policy = execution_policy::automatic) const
+        {
+            return get_aabb(policy).to_bounds();
+        }
+
+        [[maybe_unused]] friend void operator|=(bounds<dimension_count>& bounds, const indexed_body& body)
+        {
+            bounds |= body.get_bounds();
+        }
+
+        [[nodiscard, maybe_unused]] friend bounds<dimension_count> operator|(
+                const bounds<dimension_count>& old_bounds, const indexed_body& body)
+        {
+            bounds<dimension_count> new_bounds{old_bounds};
+            new_bounds |= body;
+            return new_bounds;
+        }
+
+
+        // Shared edges are added only once.
+        [[maybe_unused]] friend void operator+=(wireframe& wireframe_to_expand, const indexed_body& body)
+        {
+            using wire = typename wireframe::wire;
+
+            for (const auto& [begin, end] : body._get_unique_edges())
+                wireframe_to_expand += wire{body.get_point(begin), body.get_point(end)};
+        }
+
+
+#ifndef NDEBUG
+
+        [[maybe_unused]] friend std::ostream& operator<<(std::ostream& output_stream, const indexed_body& body)
+        {
+            output_stream << "Triangles:" << std::endl;
+
+            for (size_t i = 0 ; i < body.triangle_count() ; ++i) output_stream << body.get_triangle(i);
+
+            return output_stream << std::endl;
+        }
+
+#endif
+
+
+        // Modifiers
+
+        [[maybe_unused]] vertex_index operator+=(const point& point)
+        {
+            if (vertex_count() >= vertex_index_max)
+            {
+                throw std::length_error("Indexed body vertex count exceeds the vertex index range.");
+            }
+
+            for (small_natural_number component = 0 ; component < component_count ; ++component)
+                _coordinates[component].emplace_back(point[component]);
+
+            _invalidate_topology();
+
+            return static_cast<vertex_index>(vertex_count() - 1);
+        }
+
+        [[maybe_unused]] void operator+=(const triangle_indices& indices)
+        {
+            for (const auto index : indices)
+            {
+                if (index >= vertex_count())
+                {
+                    throw std::out_of_range("Triangle references a vertex that is not in the body.");
+                }
+            }
+
+            _triangles.emplace_back(indices);
+
+            _invalidate_topology();
+        }
+
+
+        [[maybe_unused]] void normalize(const execution_policy policy = execution_policy::automatic)
+        {
+            const auto spans = _get_spans();
+
+            parallel_for_ranges(
+                    policy, vertex_count(), parallel_range_size, [&spans](const size_t begin, const size_t end)
+                    {
+                        point_kernels<dimension_count>::normalize(_offset(spans, begin), end - begin);
+                    });
+
+            _invalidate_positions();
+        }
+
+        [[maybe_unused]] void transform(
+                const transformation<dimension_count>& transformation,
+                const execution_policy policy = execution_policy::automatic)
+        {
+            const auto input = get_coordinate_spans();
+            const auto output = _get_spans();
+
+            parallel_for_ranges(
+                    policy, vertex_count(), parallel_range_size, [&](const size_t begin, const size_t end)
+                    {
+                        point_kernels<dimension_count>::transform(
+                                _offset(input, begin), _offset(output, begin), end - begin, transformation);
+                    });
+
+            _invalidate_positions();
+        }
+
+        [[maybe_unused]] void operator*=(const transformation<dimension_count>& transformation)
+        {
+            transform(transformation);
+        }
+
+
+
+        // 3D
+
+        // Accessors
+
+        // Unit normals of all vertices, each the area weighted average of the triangles around it. They are
+        // computed on first use and cached until vertices move or the topology changes. In parallel, face
+        // normals are computed first and then gathered per vertex; the sums are added in the same order either
+        // way, so both paths give identical results.
+        ENABLE_IF_TEMPLATE(dimension_count == d3::dimension_count)
+        [[nodiscard, maybe_unused]] const std::vector<d3::plane_normal>& get_vertex_normals(
+                const execution_policy policy = execution_policy::automatic) const
+        {
+            if (_are_vertex_normals_dirty)
+            {
+                if (policy == execution_policy::sequential ||
+                    (policy == execution_policy::automatic && triangle_count() < 2 * parallel_range_size))
+                    _compute_vertex_normals();
+                else _compute_vertex_normals_in_parallel();
+
+                _are_vertex_normals_dirty = false;
+            }
+
+            return _vertex_normals;
+        }
+
+        // Planes of all triangles as half-spaces, which bound the body if it is convex. Cached until vertices
+        // move or the topology changes.
+        ENABLE_IF_TEMPLATE(dimension_count == d3::dimension_count)
+        [[nodiscard, maybe_unused]] const half_spaces& get_half_spaces() const
+        {
+            if (!_half_spaces) _half_spaces.emplace(*this);
+
+            return *_half_spaces;
+        }
+
+
+        // Modifiers
+
+        ENABLE_IF_TEMPLATE(dimension_count == d3::dimension_count)
+        [[maybe_unused]] void operator&=(const d3::bounds& bounds)
+        {
+            const auto current_bounds = get_bounds();
+
+            const auto translation_difference =
+                    bounds.get_center() - current_bounds.get_center();
+            const auto&& translation =
+                    d3::get_translation(
+                            translation_difference.x,
+                            translation_difference.y,
+                            translation_difference.z);
+
+            const auto scaling_factors =
+                    bounds.get_difference() / current_bounds.get_difference();
+            const auto min_scaling_factor =
+                    std::min(scaling_factors.x, std::min(scaling_factors.y, scaling_factors.z));
+
+            const auto&& scale_transformation =
+                    d3::get_scale_transformation(min_scaling_factor);
+
+            *this *= translation * scale_transformation;
+        }
+
+        ENABLE_IF_TEMPLATE(dimension_count == d3::dimension_count)
+        [[maybe_unused]] void operator&=(const rational_number limit)
+        {
+            *this &= d3::bounds
+                    {
+                            -limit,
+                            limit,
+
+                            -limit,
+                            limit,
+
+                            -limit,
+                            limit
+                    };
+        }
+
+
+        // Implementation details
+
+    private:
+        template<
+                typename PointBeginIterator, typename PointEndIterator,
+                typename TriangleBeginIterator, typename TriangleEndIterator>
+        void _assign(
+                const PointBeginIterator& points_begin, const PointEndIterator& points_end,
+                const TriangleBeginIterator& triangles_begin, const TriangleEndIterator& triangles_end)
+        {
+            for (auto current = points_begin ; current != points_end ; ++current) *this += *current;
+            for (auto current = triangles_begin ; current != triangles_end ; ++current) *this += *current;
+        }
+
+        [[nodiscard]] typename point_kernels<dimension_count>::spans _get_spans() noexcept
+        {
+            typename point_kernels<dimension_count>::spans result{ };
+            for (small_natural_number component = 0 ; component < component_count ; ++component)
+                result[component] = _coordinates[component].data();
+
+            return result;
+        }
+
+
+        template<typename Spans>
+        [[nodiscard]] static Spans _offset(Spans spans, const size_t offset) noexcept
+        {
+            for (auto& span : spans) span += offset;
+            return spans;
+        }
+
+
+        void _invalidate_positions() noexcept
+        {
+            _is_aabb_dirty = true;
+            _are_vertex_normals_dirty = true;
+            _half_spaces.reset();
+        }
+
+        void _invalidate_topology() noexcept
+        {
+            _adjacency.reset();
+            _invalidate_positions();
+        }
+
+
+        [[nodiscard]] d3::plane_normal _get_face_normal(const size_t triangle_index) const
+        {
+            const auto& indices = _triangles[triangle_index];
+
+            return d3::get_plane_normal(
+                    d3::to_cartesian_coordinates(get_point(indices[0])),
+                    d3::to_cartesian_coordinates(get_point(indices[1])),
+                    d3::to_cartesian_coordinates(get_point(indices[2])));
+        }
+
+        [[nodiscard]] static d3::plane_normal _get_unit_normal(const d3::plane_normal& normal) noexcept
+        {
+            const auto length = glm::length(normal);
+
+            return length > rational_zero ? normal / length : normal;
+        }
+
+        void _compute_vertex_normals() const
+        {
+            _vertex_normals.assign(vertex_count(), d3::plane_normal{rational_zero});
+
+            for (size_t i = 0 ; i < triangle_count() ; ++i)
+            {
+                // The length of a plane normal is twice the area of the triangle, which does the weighting.
+                const auto face_normal = _get_face_normal(i);
+                for (const auto index : _triangles[i]) _vertex_normals[index] += face_normal;
+            }
+
+            for (auto& normal : _vertex_normals) normal = _get_unit_normal(normal);
+        }
+
+        void _compute_vertex_normals_in_parallel() const
+        {
+            const auto& adjacency = get_adjacency();
+
+            _face_normals.resize(triangle_count());
+            parallel_for_ranges(
+                    execution_policy::parallel, triangle_count(), parallel_range_size,
+                    [this](const size_t begin, const size_t end)
+                    {
+                        for (auto i = begin ; i < end ; ++i) _face_normals[i] = _get_face_normal(i);
+                    });
+
+            // Every vertex gathers from its own faces, so no two threads write to the same normal.
+            _vertex_normals.resize(vertex_count());
+            parallel_for_ranges(
+                    execution_policy::parallel, vertex_count(), parallel_range_size,
+                    [this, &adjacency](const size_t begin, const size_t end)
+                    {
+                        for (auto vertex = begin ; vertex < end ; ++vertex)
+                        {
+                            d3::plane_normal sum{rational_zero};
+                            for (const auto face : adjacency.get_vertex_faces(static_cast<vertex_index>(vertex)))
+                                sum += _face_normals[face];
+
+                            _vertex_normals[vertex] = _get_unit_normal(sum);
+                        }
+                    });
+        }
+
+
+        [[nodiscard]] std::vector<std::pair<vertex_index, vertex_index>> _get_unique_edges() const
+        {
+            std::vector<std::pair<vertex_index, vertex_index>> result{ };
+            result.reserve(_triangles.size() * triangle_vertex_count);
+
+            for (const auto& indices : _triangles)
+            {
+                for (small_natural_number i = 0 ; i < triangle_vertex_count ; ++i)
+                {
+                    const auto begin = indices[i];
+                    const auto end = indices[(i + 1) % triangle_vertex_count];
+
+                    result.emplace_back(std::min(begin, end), std::max(begin, end));
+                }
+            }
+
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+
+            return result;
+        }
+
+
+        // Data
+
+        std::array<coordinates, component_count> _coordinates{ };
+        std::vector<triangle_indices> _triangles{ };
+
+        mutable std::optional<mesh_adjacency> _adjacency{ };
+
+        mutable aabb<dimension_count> _aabb{ };
+        mutable bool _is_aabb_dirty{true};
+
+        mutable std::vector<d3::plane_normal> _vertex_normals{ };
+        mutable std::vector<d3::plane_normal> _face_normals{ };
+        mutable bool _are_vertex_normals_dirty{true};
+
+        mutable std::optional<half_spaces> _half_spaces{ };
+    };
+
+
+    // Convex
+
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] convex_indexed_body : public indexed_body<DimensionCount>
+    {
+    public:
+        using indexed_body<DimensionCount>::indexed_body;
+
+        [[nodiscard, maybe_unused]] convex_indexed_body() = default;
+
+        [[nodiscard, maybe_unused]] explicit convex_indexed_body(indexed_body<DimensionCount> body) :
+                indexed_body<DimensionCount>{std::move(body)}
+        { }
+
+
+        [[nodiscard, maybe_unused]] containment classify(
+                const d3::point& point, const rational_number tolerance = half_spaces::default_tolerance) const
+        {
+            return this->get_half_spaces().classify(point, tolerance);
+        }
+
+        [[maybe_unused]] void classify(
+                const d3::point_kernels::const_spans& points, const size_t count, containment* results,
+                const rational_number tolerance = half_spaces::default_tolerance) const
+        {
+            this->get_half_spaces().classify(points, count, results, tolerance);
+        }
+
+
+        // Strictly inside, points on the boundary are not.
+        [[nodiscard]] friend bool operator<(const d3::point& point, const convex_indexed_body& body)
+        {
+            return body.classify(point) == containment::inside;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,440 @@
+#ifndef IRGLAB_OBJECT_PARSER_HPP
+#define IRGLAB_OBJECT_PARSER_HPP
+
+
+#include "external/external.hpp"
+
+
+#include "primitive/primitive.hpp"
+
+#include "indexed_body.hpp"
+
+
+namespace il
+{
+    // Everything a Wavefront .obj file describes about a body. Texture and normal triangles run parallel to
+    // the body triangles and hold vertex_index_max where a face corner doesn't reference that attribute.
+
+    struct [[maybe_unused]] object_description
+    {
+        d3::indexed_body body;
+
+        std::vector<d3::cartesian_coordinates> normals;
+        std::vector<d2::cartesian_coordinates> texture_coordinates;
+
+        std::vector<triangle_indices> normal_triangles;
+        std::vector<triangle_indices> texture_triangles;
+    };
+
+
+    // The text is split into newline-aligned chunks which are parsed on separate threads and then merged in
+    // file order, so the result doesn't depend on the number of threads. Negative (relative) indices are
+    // resolved against everything defined before the face, including earlier chunks, and polygons with more
+    // than three vertices are triangulated as fans.
+
+    class [[maybe_unused]] object_parser
+    {
+    public:
+        [[maybe_unused]] static constexpr size_t minimum_chunk_size = 1 << 20;
+
+
+        [[nodiscard, maybe_unused]] static object_description parse(const std::string_view text)
+        {
+            const auto chunk_texts = _split(text);
+            std::vector<_chunk> chunks(chunk_texts.size());
+
+            run_parallel(
+                    chunks.size(), [&](const size_t i)
+                    {
+                        _parse_chunk(chunk_texts[i], chunks[i]);
+                    });
+
+            return _merge(chunks);
+        }
+
+
+        // Implementation details
+
+    private:
+        using _encoded_index = std::int64_t;
+        using _encoded_indices = std::array<_encoded_index, 3>;
+
+        static constexpr _encoded_index _missing_index = std::numeric_limits<_encoded_index>::min();
+
+        static constexpr small_natural_number _position_component_count = d3::dimension_count + small_one;
+
+
+        struct _attribute_counts
+        {
+            size_t positions{0};
+            size_t normals{0};
+            size_t texture_coordinates{0};
+            size_t triangles{0};
+        };
+
+        struct _chunk
+        {
+            std::array<std::vector<rational_number>, _position_component_count> positions{ };
+            std::vector<d3::cartesian_coordinates> normals{ };
+            std::vector<d2::cartesian_coordinates> texture_coordinates{ };
+
+            std::vector<_encoded_indices> position_triangles{ };
+            std::vector<_encoded_indices> normal_triangles{ };
+            std::vector<_encoded_indices> texture_triangles{ };
+
+            // Scratch space for the corners of the face being parsed.
+            std::vector<std::array<_encoded_index, 3>> corners{ };
+
+
+            [[nodiscard]] _attribute_counts counts() const noexcept
+            {
+                return {positions[0].size(), normals.size(), texture_coordinates.size(), position_triangles.size()};
+            }
+        };
+
+
+        // Threading
+
+        [[nodiscard]] static size_t _get_thread_count(const size_t work_size) noexcept
+        {
+            const auto hardware_thread_count = static_cast<size_t>(std::thread::hardware_concurrency());
+
+            return std::max(
+                    static_cast<size_t>(1),
+                    std::min(hardware_thread_count, work_size / minimum_chunk_size));
+        }
+
+
+        // Splitting
+
+        [[nodiscard]] static std::vector<std::string_view> _split(const std::string_view text)
+        {
+            const auto chunk_count = _get_thread_count(text.size());
+
+            std::vector<std::string_view> result{ };
+            result.reserve(chunk_count);
+
+            size_t begin = 0;
+            for (size_t i = 1 ; i <= chunk_count && begin < text.size() ; ++i)
+            {
+                auto end = i == chunk_count ? text.size() : text.size() * i / chunk_count;
+                if (end < begin) end = begin;
+
+                const auto newline = text.find('\n', end);
+                end = newline == std::string_view::npos ? text.size() : newline + 1;
+
+                result.emplace_back(text.substr(begin, end - begin));
+                begin = end;
+            }
+
+            if (result.empty()) result.emplace_back();
+
+            return result;
+        }
+
+
+        // Scanning
+
+        [[nodiscard]] static bool _is_blank(const char character) noexcept
+        {
+            return character == ' ' || character == '\t' || character == '\r';
+        }
+
+        [[nodiscard]] static const char* _skip_blanks(const char* current, const char* end) noexcept
+        {
+            while (current < end && _is_blank(*current)) ++current;
+            return current;
+        }
+
+        [[nodiscard]] static const char* _skip_token(const char* current, const char* end) noexcept
+        {
+            while (current < end && !_is_blank(*current)) ++current;
+            return current;
+        }
+
+        [[nodiscard]] static bool _parse_rational(const char*& current, const char* end, rational_number& result)
+        {
+            current = _skip_blanks(current, end);
+            if (current == end || *current == '#') return false;
+
+            // from_chars doesn't accept a leading plus sign.
+            if (*current == '+') ++current;
+
+            const auto [next, error] = std::from_chars(current, end, result);
+            if (error != std::errc{ })
+            {
+                throw std::runtime_error("Malformed number in object file.");
+            }
+
+            current = next;
+            return true;
+        }
+
+        [[nodiscard]] static _encoded_index _parse_index(
+                const char*& current, const char* end, const size_t defined_count)
+        {
+            long long int index;
+
+            const auto [next, error] = std::from_chars(current, end, index);
+            if (error != std::errc{ } || index == 0)
+            {
+                throw std::runtime_error("Malformed face index in object file.");
+            }
+
+            current = next;
+
+            // Numbering in .obj files starts with 1 and negative numbers count back from the last definition.
+            // Absolute indices are stored doubled and relative ones doubled plus one, so the merge step can
+            // tell them apart and add the offset of the chunk to the relative ones.
+            return index > 0 ?
+                   2 * static_cast<_encoded_index>(index - 1) :
+                   2 * (static_cast<_encoded_index>(defined_count) + index) + 1;
+        }
+
+        [[nodiscard]] static vertex_index _decode_index(
+                const _encoded_index encoded_index, const size_t chunk_offset, const size_t total_count)
+        {
+            if (encoded_index == _missing_index) return vertex_index_max;
+
+            const auto decoded_index = encoded_index % 2 == 0 ?
+                                       encoded_index / 2 :
+                                       static_cast<_encoded_index>(chunk_offset) + (encoded_index - 1) / 2;
+
+            if (decoded_index < 0 || static_cast<size_t>(decoded_index) >= total_count)
+            {
+                throw std::out_of_range("Face references a vertex that is not in the object file.");
+            }
+
+            return static_cast<vertex_index>(decoded_index);
+        }
+
+
+        // Parsing
+
+        static void _parse_chunk(const std::string_view text, _chunk& chunk)
+        {
+            const char* current = text.data();
+            const char* const end = current + text.size();
+
+            while (current < end)
+            {
+                const auto line_end = static_cast<const char*>(std::memchr(current, '\n', end - current));
+                const auto next_line = line_end == nullptr ? end : line_end;
+
+                _parse_line(current, next_line, chunk);
+
+                current = next_line + 1;
+            }
+        }
+
+        static void _parse_line(const char* current, const char* end, _chunk& chunk)
+        {
+            current = _skip_blanks(current, end);
+            if (current == end || *current == '#') return;
+
+            const auto keyword_end = _skip_token(current, end);
+            const std::string_view keyword{current, static_cast<size_t>(keyword_end - current)};
+            current = keyword_end;
+
+            if (keyword == "v") _parse_position(current, end, chunk);
+            else if (keyword == "vn") _parse_normal(current, end, chunk);
+            else if (keyword == "vt") _parse_texture_coordinates(current, end, chunk);
+            else if (keyword == "f") _parse_face(current, end, chunk);
+        }
+
+        static void _parse_position(const char* current, const char* end, _chunk& chunk)
+        {
+            std::array<rational_number, _position_component_count> position{0.0f, 0.0f, 0.0f, 1.0f};
+
+            for (small_natural_number i = 0 ; i < d3::dimension_count ; ++i)
+            {
+                if (!_parse_rational(current, end, position[i]))
+                {
+                    throw std::runtime_error("Vertex in object file has less than three coordinates.");
+                }
+            }
+
+            // The optional fourth coordinate is the homogeneous one, unless more follow, in which case they
+            // are the widespread vertex color extension and the vertex is not homogeneous.
+            if (_parse_rational(current, end, position[d3::dimension_count]))
+            {
+                rational_number ignored;
+                if (_parse_rational(current, end, ignored)) position[d3::dimension_count] = rational_one;
+            }
+
+            for (small_natural_number i = 0 ; i < _position_component_count ; ++i)
+                chunk.positions[i].emplace_back(position[i]);
+        }
+
+        static void _parse_normal(const char* current, const char* end, _chunk& chunk)
+        {
+            d3::cartesian_coordinates normal{ };
+
+            for (small_natural_number i = 0 ; i < d3::dimension_count ; ++i)
+            {
+                if (!_parse_rational(current, end, normal[i]))
+                {
+                    throw std::runtime_error("Vertex normal in object file has less than three coordinates.");
+                }
+            }
+
+            chunk.normals.emplace_back(normal);
+        }
+
+        static void _parse_texture_coordinates(const char* current, const char* end, _chunk& chunk)
+        {
+            d2::cartesian_coordinates texture_coordinates{ };
+
+            if (!_parse_rational(current, end, texture_coordinates.x))
+            {
+                throw std::runtime_error("Texture coordinates in object file are empty.");
+            }
+
+            // The second coordinate is optional and the third one is not used.
+            static_cast<void>(_parse_rational(current, end, texture_coordinates.y));
+
+            chunk.texture_coordinates.emplace_back(texture_coordinates);
+        }
+
+        // Corners are 'position', 'position/texture', 'position//normal' or 'position/texture/normal'.
+        static void _parse_face(const char* current, const char* end, _chunk& chunk)
+        {
+            const auto counts = chunk.counts();
+            chunk.corners.clear();
+
+            for (current = _skip_blanks(current, end) ;
+                 current < end && *current != '#' ;
+                 current = _skip_blanks(current, end))
+            {
+                std::array<_encoded_index, 3> corner{_missing_index, _missing_index, _missing_index};
+
+                corner[0] = _parse_index(current, end, counts.positions);
+
+                if (current < end && *current == '/')
+                {
+                    ++current;
+                    if (current < end && *current != '/')
+                        corner[1] = _parse_index(current, end, counts.texture_coordinates);
+
+                    if (current < end && *current == '/')
+                    {
+                        ++current;
+                        corner[2] = _parse_index(current, end, counts.normals);
+                    }
+                }
+
+                if (current < end && !_is_blank(*current))
+                {
+                    throw std::runtime_error("Malformed face corner in object file.");
+                }
+
+                chunk.corners.emplace_back(corner);
+            }
+
+            if (chunk.corners.size() < 3)
+            {
+                throw std::runtime_error("Face in object file has less than three vertices.");
+            }
+
+            const auto& first = chunk.corners.front();
+            for (size_t i = 1 ; i + 1 < chunk.corners.size() ; ++i)
+            {
+                const auto& second = chunk.corners[i];
+                const auto& third = chunk.corners[i + 1];
+
+                chunk.position_triangles.push_back({first[0], second[0], third[0]});
+                chunk.texture_triangles.push_back({first[1], second[1], third[1]});
+                chunk.normal_triangles.push_back({first[2], second[2], third[2]});
+            }
+        }
+
+
+        // Merging
+
+        [[nodiscard]] static object_description _merge(std::vector<_chunk>& chunks)
+        {
+            std::vector<_attribute_counts> offsets(chunks.size());
+            _attribute_counts totals{ };
+
+            for (size_t i = 0 ; i < chunks.size() ; ++i)
+            {
+                const auto counts = chunks[i].counts();
+                offsets[i] = totals;
+
+                totals.positions += counts.positions;
+                totals.normals += counts.normals;
+                totals.texture_coordinates += counts.texture_coordinates;
+                totals.triangles += counts.triangles;
+            }
+
+            std::array<std::vector<rational_number>, _position_component_count> positions{ };
+            for (auto& component : positions) component.resize(totals.positions);
+
+            object_description result{ };
+            result.normals.resize(totals.normals);
+            result.texture_coordinates.resize(totals.texture_coordinates);
+            result.normal_triangles.resize(totals.triangles);
+            result.texture_triangles.resize(totals.triangles);
+
+            std::vector<triangle_indices> position_triangles(totals.triangles);
+
+            run_parallel(
+                    chunks.size(), [&](const size_t i)
+                    {
+                        auto& chunk = chunks[i];
+                        const auto& offset = offsets[i];
+
+                        for (small_natural_number component = 0 ; component < _position_component_count ; ++component)
+                        {
+                            std::copy(
+                                    chunk.positions[component].begin(), chunk.positions[component].end(),
+                                    positions[component].begin() + offset.positions);
+                        }
+
+                        std::copy(
+                                chunk.normals.begin(), chunk.normals.end(),
+                                result.normals.begin() + offset.normals);
+                        std::copy(
+                                chunk.texture_coordinates.begin(), chunk.texture_coordinates.end(),
+                                result.texture_coordinates.begin() + offset.texture_coordinates);
+
+                        for (size_t j = 0 ; j < chunk.position_triangles.size() ; ++j)
+                        {
+                            for (small_natural_number k = 0 ; k < 3 ; ++k)
+                            {
+                                position_triangles[offset.triangles + j][k] = _decode_index(
+                                        chunk.position_triangles[j][k], offset.positions, totals.positions);
+                                result.texture_triangles[offset.triangles + j][k] = _decode_index(
+                                        chunk.texture_triangles[j][k],
+                                        offset.texture_coordinates, totals.texture_coordinates);
+                                result.normal_triangles[offset.triangles + j][k] = _decode_index(
+                                        chunk.normal_triangles[j][k], offset.normals, totals.normals);
+                            }
+                        }
+
+                        chunk = _chunk{ };
+                    });
+
+            result.body = d3::indexed_body{std::move(positions), std::move(position_triangles)};
+
+            return result;
+        }
+    };
+
+
+    [[nodiscard, maybe_unused]] inline object_description parse_object(const std::string_view text)
+    {
+        return object_parser::parse(text);
+    }
+
+
+    // Parsing operator
+
+    [[nodiscard, maybe_unused]] inline indexed_body<3> operator ""_indexed_body(
+            const char* chars, const size_t size)
+    {
+        return parse_object(std::string_view{chars, size}).body;
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef IRGLAB_AABB_HPP
+#define IRGLAB_AABB_HPP
+
+
+#include "external/external.hpp"
+
+#include "primitives.hpp"
+#include "bounds.hpp"
+
+
+namespace il
+{
+    // Declaration
+
+    template<small_natural_number DimensionCount>
+    struct [[maybe_unused]] aabb;
+
+
+    // Dimensional aliases
+
+    namespace d2
+    {
+        using aabb [[maybe_unused]] = il::aabb<dimension_count>;
+    }
+    namespace d3
+    {
+        using aabb [[maybe_unused]] = il::aabb<dimension_count>;
+    }
+
+
+
+    // Implementation
+
+    // Axis aligned bounding box kept as two padded, 16 byte aligned lane arrays, so that unions are plain
+    // element wise min and max the compiler can turn into single vector instructions instead of a branch
+    // per component like bounds does. Padding lanes are carried along and never read.
+    template<small_natural_number DimensionCount>
+    struct alignas(16) [[maybe_unused]] aabb
+    {
+        // Traits and types
+
+        [[maybe_unused]] static constexpr small_natural_number dimension_count = DimensionCount;
+        [[maybe_unused]] static constexpr small_natural_number lane_count = 4;
+
+        using lanes [[maybe_unused]] = std::array<rational_number, lane_count>;
+
+
+        // Union
+
+        [[maybe_unused]] aabb& operator|=(const aabb& other) noexcept
+        {
+            for (small_natural_number lane = 0 ; lane < lane_count ; ++lane)
+            {
+                minimum[lane] = std::min(minimum[lane], other.minimum[lane]);
+                maximum[lane] = std::max(maximum[lane], other.maximum[lane]);
+            }
+
+            return *this;
+        }
+
+        [[nodiscard, maybe_unused]] aabb operator|(const aabb& other) const noexcept
+        {
+            auto result{*this};
+            return result |= other;
+        }
+
+        [[maybe_unused]] aabb& operator|=(const point<dimension_count>& point) noexcept
+        {
+            for (small_natural_number lane = 0 ; lane < dimension_count ; ++lane)
+            {
+                minimum[lane] = std::min(minimum[lane], point[lane]);
+                maximum[lane] = std::max(maximum[lane], point[lane]);
+            }
+
+            return *this;
+        }
+
+
+        // Non-modifiers
+
+        [[nodiscard, maybe_unused]] bool is_empty() const noexcept
+        {
+            return minimum[0] > maximum[0];
+        }
+
+        [[nodiscard, maybe_unused]] bool intersects(const aabb& other) const noexcept
+        {
+            bool result = true;
+            for (small_natural_number lane = 0 ; lane < dimension_count ; ++lane)
+                result &= (minimum[lane] <= other.maximum[lane]) & (other.minimum[lane] <= maximum[lane]);
+
+            return result;
+        }
+
+        [[nodiscard, maybe_unused]] bool contains(const point<dimension_count>& point) const noexcept
+        {
+            bool result = true;
+            for (small_natural_number lane = 0 ; lane < dimension_count ; ++lane)
+                result &= (minimum[lane] <= point[lane]) & (point[lane] <= maximum[lane]);
+
+            return result;
+        }
+
+
+        [[nodiscard, maybe_unused]] cartesian_coordinates<dimension_count> get_difference() const noexcept
+        {
+            cartesian_coordinates<dimension_count> result{ };
+            for (small_natural_number lane = 0 ; lane < dimension_count ; ++lane)
+                result[lane] = maximum[lane] - minimum[lane];
+
+            return result;
+        }
+
+        [[nodiscard, maybe_unused]] cartesian_coordinates<dimension_count> get_center() const noexcept
+        {
+            cartesian_coordinates<dimension_count> result{ };
+            for (small_natural_number lane = 0 ; lane < dimension_count ; ++lane)
+                result[lane] = minimum[lane] + (maximum[lane] - minimum[lane]) / 2.0f;
+
+            return result;
+        }
+
+
+        [[nodiscard, maybe_unused]] bounds<dimension_count> to_bounds() const noexcept
+        {
+            if constexpr (dimension_count == d2::dimension_count)
+                return bounds<dimension_count>{minimum[0], maximum[0], minimum[1], maximum[1]};
+            else
+                return bounds<dimension_count>
+                        {
+                                minimum[0], maximum[0],
+                                minimum[1], maximum[1],
+                                minimum[2], maximum[2]
+                        };
+        }
+
+
+        // Data
+
+        // Empty boxes have minimum above maximum, so the first union replaces both.
+        lanes minimum{rational_number_max, rational_number_max, rational_number_max, rational_number_max};
+        lanes maximum{rational_number_min, rational_number_min, rational_number_min, rational_number_min};
+    };
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef IRGLAB_INDICES_HPP
+#define IRGLAB_INDICES_HPP
+
+
+#include "external/external.hpp"
+
+
+namespace il
+{
+    using vertex_index [[maybe_unused]] = std::uint32_t;
+
+    [[maybe_unused]] inline constexpr vertex_index vertex_index_max = UINT32_MAX;
+
+    using triangle_indices [[maybe_unused]] = std::array<vertex_index, 3>;
+}
+
+#endif
@@ -0,0 +1,379 @@
+#ifndef IRGLAB_KERNELS_HPP
+#define IRGLAB_KERNELS_HPP
+
+
+#include "external/external.hpp"
+
+#include "primitives.hpp"
+#include "transformations.hpp"
+#include "aabb.hpp"
+
+
+namespace il
+{
+    // Declaration
+
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] point_kernels;
+
+
+    // Dimensional aliases
+
+    namespace d2
+    {
+        using point_kernels [[maybe_unused]] = il::point_kernels<dimension_count>;
+    }
+    namespace d3
+    {
+        using point_kernels [[maybe_unused]] = il::point_kernels<dimension_count>;
+    }
+
+
+
+    // Implementation
+
+    // Batch operations over points stored as one array per homogeneous component, which is how indexed bodies
+    // keep them. Each kernel runs as many points as fit into the widest available registers (8 with AVX2,
+    // 4 with SSE) and finishes the rest with the same code on scalars. The instruction set is chosen at compile
+    // time. Both paths do the same operations in the same order, so results don't depend on the point count or
+    // the instruction set.
+    template<small_natural_number DimensionCount>
+    class [[maybe_unused]] point_kernels
+    {
+        // Traits and types
+
+    public:
+        [[maybe_unused]] static constexpr small_natural_number dimension_count = DimensionCount;
+        [[maybe_unused]] static constexpr small_natural_number component_count = DimensionCount + small_one;
+
+
+        using spans [[maybe_unused]] = std::array<rational_number*, component_count>;
+        using const_spans [[maybe_unused]] = std::array<const rational_number*, component_count>;
+
+
+#if defined(__AVX2__)
+        [[maybe_unused]] static constexpr const char* instruction_set = "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        [[maybe_unused]] static constexpr const char* instruction_set = "SSE2";
+#else
+        [[maybe_unused]] static constexpr const char* instruction_set = "scalar";
+#endif
+
+
+        // Kernels
+
+        // Computes point * transformation for every point. Output may be the same as input.
+        [[maybe_unused]] static void transform(
+                const const_spans& input, const spans& output, const size_t count,
+                const transformation<dimension_count>& transformation) noexcept
+        {
+            const auto begin = _transform<_wide_lanes>(input, output, 0, count, transformation);
+            _transform<_scalar_lanes>(input, output, begin, count, transformation);
+        }
+
+        // Divides every point by its homogeneous component, which becomes one.
+        [[maybe_unused]] static void normalize(const spans& points, const size_t count) noexcept
+        {
+            const auto begin = _normalize<_wide_lanes>(points, 0, count);
+            _normalize<_scalar_lanes>(points, begin, count);
+        }
+
+
+        // Folds all points into the box with one running minimum and maximum per component and register lane,
+        // which are combined only at the end. Homogeneous components are used as they are, like bounds does.
+        [[maybe_unused]] static void reduce_bounds(
+                const const_spans& points, const size_t count, aabb<dimension_count>& box) noexcept
+        {
+            const auto begin = _reduce_bounds<_wide_lanes>(points, 0, count, box);
+            _reduce_bounds<_scalar_lanes>(points, begin, count, box);
+        }
+
+        // Writes the largest signed distance of every point to the planes, which are given as one array per
+        // coefficient and must have unit normals. Points need a positive homogeneous component. A group of points
+        // stops going through the planes once all of them are further than stop_distance, so distances above it
+        // are only lower bounds.
+        ENABLE_IF_TEMPLATE(dimension_count == d3::dimension_count)
+        [[maybe_unused]] static void reduce_plane_distances(
+                const const_spans& points, const size_t count,
+                const const_spans& planes, const size_t plane_count,
+                const rational_number stop_distance, rational_number* distances) noexcept
+        {
+            const auto begin = _reduce_plane_distances<_wide_lanes>(
+                    points, 0, count, planes, plane_count, stop_distance, distances);
+            _reduce_plane_distances<_scalar_lanes>(
+                    points, begin, count, planes, plane_count, stop_distance, distances);
+        }
+
+        // Writes the indices of all planes the point is strictly above to selected, in increasing order, and
+        // returns how many there are. Planes are given as one array per coefficient and selected needs room
+        // for all of them.
+        ENABLE_IF_TEMPLATE(dimension_count == d3::dimension_count)
+        [[maybe_unused]] static size_t select_above(
+                const const_spans& planes, const size_t plane_count,
+                const cartesian_coordinates<dimension_count>& point, std::uint32_t* selected) noexcept
+        {
+            size_t selected_count = 0;
+            const auto begin = _select_above<_wide_lanes>(planes, 0, plane_count, point, selected, selected_count);
+            _select_above<_scalar_lanes>(planes, begin, plane_count, point, selected, selected_count);
+
+            return selected_count;
+        }
+
+
+        // Implementation details
+
+    private:
+        struct _scalar_lanes
+        {
+            using type = rational_number;
+            static constexpr size_t width = 1;
+
+            static type load(const rational_number* source) noexcept { return *source; }
+            static void store(rational_number* destination, const type value) noexcept { *destination = value; }
+            static type broadcast(const rational_number value) noexcept { return value; }
+
+            static type add(const type first, const type second) noexcept { return first + second; }
+            static type multiply(const type first, const type second) noexcept { return first * second; }
+            static type divide(const type first, const type second) noexcept { return first / second; }
+
+            static type minimum(const type first, const type second) noexcept { return std::min(first, second); }
+            static type maximum(const type first, const type second) noexcept { return std::max(first, second); }
+
+            static bool all_greater(const type first, const type second) noexcept { return first > second; }
+            static unsigned greater_mask(const type first, const type second) noexcept
+            { return first > second ? 1u : 0u; }
+        };
+
+#if defined(__AVX2__)
+        struct _wide_lanes
+        {
+            using type = __m256;
+            static constexpr size_t width = 8;
+
+            static type load(const rational_number* source) noexcept { return _mm256_loadu_ps(source); }
+            static void store(rational_number* destination, const type value) noexcept
+            { _mm256_storeu_ps(destination, value); }
+            static type broadcast(const rational_number value) noexcept { return _mm256_set1_ps(value); }
+
+            static type add(const type first, const type second) noexcept { return _mm256_add_ps(first, second); }
+            static type multiply(const type first, const type second) noexcept
+            { return _mm256_mul_ps(first, second); }
+            static type divide(const type first, const type second) noexcept
+            { return _mm256_div_ps(first, second); }
+
+            static type minimum(const type first, const type second) noexcept
+            { return _mm256_min_ps(first, second); }
+            static type maximum(const type first, const type second) noexcept
+            { return _mm256_max_ps(first, second); }
+
+            static bool all_greater(const type first, const type second) noexcept
+            { return greater_mask(first, second) == 0xFF; }
+            static unsigned greater_mask(const type first, const type second) noexcept
+            { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(first, second, _CMP_GT_OQ))); }
+        };
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        struct _wide_lanes
+        {
+            using type = __m128;
+            static constexpr size_t width = 4;
+
+            static type load(const rational_number* source) noexcept { return _mm_loadu_ps(source); }
+            static void store(rational_number* destination, const type value) noexcept
+            { _mm_storeu_ps(destination, value); }
+            static type broadcast(const rational_number value) noexcept { return _mm_set1_ps(value); }
+
+            static type add(const type first, const type second) noexcept { return _mm_add_ps(first, second); }
+            static type multiply(const type first, const type second) noexcept { return _mm_mul_ps(first, second); }
+            static type divide(const type first, const type second) noexcept { return _mm_div_ps(first, second); }
+
+            static type minimum(const type first, const type second) noexcept { return _mm_min_ps(first, second); }
+            static type maximum(const type first, const type second) noexcept { return _mm_max_ps(first, second); }
+
+            static bool all_greater(const type first, const type second) noexcept
+            { return greater_mask(first, second) == 0xF; }
+            static unsigned greater_mask(const type first, const type second) noexcept
+            { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpgt_ps(first, second))); }
+        };
+#else
+        using _wide_lanes = _scalar_lanes;
+#endif
+
+
+        // Returns the broadcast coefficients so that result component j is the sum over k of
+        // component k times coefficient [j][k]. With row vectors that is column j of the transformation.
+        template<typename Lanes>
+        [[nodiscard]] static std::array<std::array<typename Lanes::type, component_count>, component_count>
+        _broadcast(const transformation<dimension_count>& transformation) noexcept
+        {
+            std::array<std::array<typename Lanes::type, component_count>, component_count> result{ };
+            for (small_natural_number j = 0 ; j < component_count ; ++j)
+                for (small_natural_number k = 0 ; k < component_count ; ++k)
+                    result[j][k] = Lanes::broadcast(transformation[j][k]);
+
+            return result;
+        }
+
+        template<typename Lanes>
+        [[nodiscard]] static std::array<typename Lanes::type, component_count> _transform_lanes(
+                const const_spans& input, const size_t i,
+                const std::array<std::array<typename Lanes::type, component_count>, component_count>& coefficients)
+        noexcept
+        {
+            std::array<typename Lanes::type, component_count> components{ };
+            for (small_natural_number k = 0 ; k < component_count ; ++k) components[k] = Lanes::load(input[k] + i);
+
+            std::array<typename Lanes::type, component_count> result{ };
+            for (small_natural_number j = 0 ; j < component_count ; ++j)
+            {
+                auto sum = Lanes::multiply(components[0], coefficients[j][0]);
+                for (small_natural_number k = 1 ; k < component_count ; ++k)
+                    sum = Lanes::add(sum, Lanes::multiply(components[k], coefficients[j][k]));
+
+                result[j] = sum;
+            }
+
+            return result;
+        }
+
+
+        // Each of these processes whole lanes from begin on and returns where it stopped.
+
+        template<typename Lanes>
+        static size_t _transform(
+                const const_spans& input, const spans& output, size_t begin, const size_t end,
+                const transformation<dimension_count>& transformation) noexcept
+        {
+            const auto coefficients = _broadcast<Lanes>(transformation);
+
+            for ( ; begin + Lanes::width <= end ; begin += Lanes::width)
+            {
+                const auto result = _transform_lanes<Lanes>(input, begin, coefficients);
+                for (small_natural_number j = 0 ; j < component_count ; ++j) Lanes::store(output[j] + begin, result[j]);
+            }
+
+            return begin;
+        }
+
+        template<typename Lanes>
+        static size_t _normalize(const spans& points, size_t begin, const size_t end) noexcept
+        {
+            const auto one = Lanes::broadcast(rational_one);
+
+            for ( ; begin + Lanes::width <= end ; begin += Lanes::width)
+            {
+                const auto homogeneous = Lanes::load(points[dimension_count] + begin);
+
+                for (small_natural_number k = 0 ; k < dimension_count ; ++k)
+                    Lanes::store(points[k] + begin, Lanes::divide(Lanes::load(points[k] + begin), homogeneous));
+
+                Lanes::store(points[dimension_count] + begin, one);
+            }
+
+            return begin;
+        }
+
+        template<typename Lanes>
+        static size_t _reduce_bounds(
+                const const_spans& points, size_t begin, const size_t end, aabb<dimension_count>& box) noexcept
+        {
+            if (begin + Lanes::width > end) return begin;
+
+            std::array<typename Lanes::type, dimension_count> minimum{ };
+            std::array<typename Lanes::type, dimension_count> maximum{ };
+            for (small_natural_number k = 0 ; k < dimension_count ; ++k)
+            {
+                minimum[k] = Lanes::broadcast(box.minimum[k]);
+                maximum[k] = Lanes::broadcast(box.maximum[k]);
+            }
+
+            for ( ; begin + Lanes::width <= end ; begin += Lanes::width)
+            {
+                for (small_natural_number k = 0 ; k < dimension_count ; ++k)
+                {
+                    const auto components = Lanes::load(points[k] + begin);
+
+                    minimum[k] = Lanes::minimum(minimum[k], components);
+                    maximum[k] = Lanes::maximum(maximum[k], components);
+                }
+            }
+
+            for (small_natural_number k = 0 ; k < dimension_count ; ++k)
+            {
+                std::array<rational_number, Lanes::width> minimum_lanes{ };
+                std::array<rational_number, Lanes::width> maximum_lanes{ };
+                Lanes::store(minimum_lanes.data(), minimum[k]);
+                Lanes::store(maximum_lanes.data(), maximum[k]);
+
+                box.minimum[k] = *std::min_element(minimum_lanes.begin(), minimum_lanes.end());
+                box.maximum[k] = *std::max_element(maximum_lanes.begin(), maximum_lanes.end());
+            }
+
+            return begin;
+        }
+
+        // Compares plane values against the stop distance scaled by the homogeneous component and divides only
+        // the final maximum, which is the same for positive homogeneous components.
+        template<typename Lanes>
+        static size_t _reduce_plane_distances(
+                const const_spans& points, size_t begin, const size_t end,
+                const const_spans& planes, const size_t plane_count,
+                const rational_number stop_distance, rational_number* distances) noexcept
+        {
+            for ( ; begin + Lanes::width <= end ; begin += Lanes::width)
+            {
+                std::array<typename Lanes::type, component_count> components{ };
+                for (small_natural_number k = 0 ; k < component_count ; ++k)
+                    components[k] = Lanes::load(points[k] + begin);
+
+                const auto stop = Lanes::multiply(Lanes::broadcast(stop_distance), components[dimension_count]);
+                auto maximum = Lanes::broadcast(rational_number_min);
+
+                for (size_t plane = 0 ; plane < plane_count ; ++plane)
+                {
+                    auto value = Lanes::multiply(components[0], Lanes::broadcast(planes[0][plane]));
+                    for (small_natural_number k = 1 ; k < component_count ; ++k)
+                        value = Lanes::add(value, Lanes::multiply(components[k], Lanes::broadcast(planes[k][plane])));
+
+                    maximum = Lanes::maximum(maximum, value);
+                    if (Lanes::all_greater(maximum, stop)) break;
+                }
+
+                Lanes::store(distances + begin, Lanes::divide(maximum, components[dimension_count]));
+            }
+
+            return begin;
+        }
+
+        // Every lane index is written and the count only advances past the selected ones, which compacts
+        // without a branch per plane.
+        template<typename Lanes>
+        static size_t _select_above(
+                const const_spans& planes, size_t begin, const size_t end,
+                const cartesian_coordinates<dimension_count>& point,
+                std::uint32_t* selected, size_t& selected_count) noexcept
+        {
+            std::array<typename Lanes::type, dimension_count> components{ };
+            for (small_natural_number k = 0 ; k < dimension_count ; ++k) components[k] = Lanes::broadcast(point[k]);
+
+            const auto zero = Lanes::broadcast(rational_zero);
+
+            for ( ; begin + Lanes::width <= end ; begin += Lanes::width)
+            {
+                auto value = Lanes::load(planes[dimension_count] + begin);
+                for (small_natural_number k = 0 ; k < dimension_count ; ++k)
+                    value = Lanes::add(value, Lanes::multiply(components[k], Lanes::load(planes[k] + begin)));
+
+                const auto mask = Lanes::greater_mask(value, zero);
+                for (size_t lane = 0 ; lane < Lanes::width ; ++lane)
+                {
+                    selected[selected_count] = static_cast<std::uint32_t>(begin + lane);
+                    selected_count += (mask >> lane) & 1u;
+                }
+            }
+
+            return begin;
+        }
+    };
+}
+
+#endif
@@ -2,8 +2,11 @@
 #define IRGLAB_PRIMITIVE_HPP
 
 
+#include "aabb.hpp"
 #include "bounds.hpp"
 #include "direction.hpp"
+#include "indices.hpp"
+#include "kernels.hpp"
 #include "primitives.hpp"
 #include "transformations.hpp"
 
@@ -79,12 +79,17 @@ namespace il
         [[maybe_unused]] static constexpr bool is_owning = true;
         [[maybe_unused]] static constexpr bool is_virtual = false;
 
+        // Wires handed to one task when an operation runs in parallel.
+        [[maybe_unused]] static constexpr size_t parallel_range_size = 1 << 13;
+
         using wire [[maybe_unused]] = il::wire<dimension_count, access_type>;
         using vertex [[maybe_unused]] = typename wire::vertex;
 
 
         // Constructors and related methods
 
+        [[nodiscard, maybe_unused]] wireframe() = default;
+
         ENABLE_IF_TEMPLATE(is_wireframe_description_supported(dimension_count, access_type))
         [[nodiscard, maybe_unused]] wireframe(const std::initializer_list<wire>& wires) : _wires{wires}
         { }
@@ -151,14 +156,30 @@ namespace il
 
         // Modifiers
 
-        [[maybe_unused]] constexpr void normalize()
+        [[maybe_unused]] void normalize(const execution_policy policy = execution_policy::automatic)
+        {
+            parallel_for_ranges(
+                    policy, _wires.size(), parallel_range_size, [this](const size_t begin, const size_t end)
+                    {
+                        for (auto i = begin ; i < end ; ++i) _wires[i].normalize();
+                    });
+        }
+
+        [[maybe_unused]] void transform(
+                const transformation<dimension_count>& transformation,
+                const execution_policy policy = execution_policy::automatic)
         {
-            for (auto& wire : _wires) wire.normalize();
+            parallel_for_ranges(
+                    policy, _wires.size(), parallel_range_size, [this, &transformation](
+                            const size_t begin, const size_t end)
+                    {
+                        for (auto i = begin ; i < end ; ++i) _wires[i] *= transformation;
+                    });
         }
 
-        [[maybe_unused]] constexpr void operator*=(const transformation<dimension_count>& transformation) noexcept
+        [[maybe_unused]] void operator*=(const transformation<dimension_count>& transformation)
         {
-            for (auto& wire : _wires) wire *= transformation;
+            transform(transformation);
         }
 
 
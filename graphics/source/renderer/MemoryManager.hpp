@@ -6,18 +6,22 @@
 
 #include "../environment/device.hpp"
 #include "swapchain.hpp"
+#include "memory_allocator.hpp"
 
 
 namespace il
 {
+    // World space vertex. The vertex shader projects and lights it with the frame uniforms.
     struct GraphicsVertex
     {
-        using PositionVector = glm::vec2;
+        using PositionVector = glm::vec3;
         using ColorVector = glm::vec3;
+        using NormalVector = glm::vec3;
 
 
-        PositionVector position{0.0f, 0.0f};
+        PositionVector position{0.0f, 0.0f, 0.0f};
         ColorVector color{0.0f, 0.0f, 0.0f};
+        NormalVector normal{0.0f, 0.0f, 0.0f};
 
 
         [[nodiscard]] static std::vector<vk::VertexInputBindingDescription>
@@ -41,7 +45,7 @@ namespace il
                             {
                                     0,
                                     0,
-                                    vk::Format::eR32G32Sfloat,
+                                    vk::Format::eR32G32B32Sfloat,
                                     offsetof(GraphicsVertex, position)
                             },
                             {
@@ -49,42 +53,185 @@ namespace il
                                     0,
                                     vk::Format::eR32G32B32Sfloat,
                                     offsetof(GraphicsVertex, color)
+                            },
+                            {
+                                    2,
+                                    0,
+                                    vk::Format::eR32G32B32Sfloat,
+                                    offsetof(GraphicsVertex, normal)
                             }
                     };
         }
     };
 
 
+    // Per frame shader inputs, laid out like the std140 uniform block of vertex_shader.vert. Matrices are
+    // applied to row vectors like on the CPU, position * model * view * clip. The defaults pass positions
+    // through unchanged and unlit, which is what the fractal needs.
+    struct frame_uniforms
+    {
+        glm::mat4 model{1.0f};
+        glm::mat4 view{1.0f};
+        glm::mat4 clip{1.0f};
+
+        glm::vec4 viewpoint{0.0f, 0.0f, 0.0f, 1.0f};
+        glm::vec4 light_position{0.0f, 0.0f, 0.0f, 1.0f};
+        glm::vec4 light_hue{1.0f, 1.0f, 1.0f, 0.0f};
+
+        // Ambient, diffuse and specular intensity of the light and its shine, and the same three coefficients
+        // of the surface. Zero shine turns lighting off.
+        glm::vec4 light_intensities{1.0f, 0.0f, 0.0f, 0.0f};
+        glm::vec4 surface_coefficients{1.0f, 0.0f, 0.0f, 0.0f};
+
+        // Projected x is divided by it, so that the image keeps its proportions on any window.
+        float aspect_ratio{1.0f};
+        std::array<float, 3> padding{ };
+    };
+
+    static_assert(sizeof(frame_uniforms) == 3 * 64 + 5 * 16 + 16);
+
+
+    // Triangle corners as indices into the vertices written with them.
+    using GraphicsIndex = std::uint32_t;
+
+    static constexpr vk::IndexType graphics_index_type = vk::IndexType::eUint32;
+
+    // Indices follow the vertices in the same buffer, which keeps them aligned.
+    static_assert(sizeof(GraphicsVertex) % sizeof(GraphicsIndex) == 0);
+
+
+    // Size of one part of the geometry, which is written and drawn on its own. Without indices, vertices are
+    // drawn in order.
+    struct geometry_counts
+    {
+        size_t vertex_count{0};
+        size_t index_count{0};
+    };
+
+
+    // Elements handed out for writing, which live in mapped device memory. Valid until the next write.
+    template<typename Element>
+    class mapped_span
+    {
+    public:
+        mapped_span(Element *begin, const size_t size) noexcept :
+                _begin{begin}, _size{size}
+        { }
+
+
+        [[nodiscard]] Element *data() const noexcept
+        {
+            return _begin;
+        }
+
+        [[nodiscard]] Element *begin() const noexcept
+        {
+            return _begin;
+        }
+
+        [[nodiscard]] Element *end() const noexcept
+        {
+            return _begin + _size;
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return _size;
+        }
+
+        [[nodiscard]] Element &operator[](const size_t index) const noexcept
+        {
+            return _begin[index];
+        }
+
+
+    private:
+        Element *_begin;
+        size_t _size;
+    };
+
+    using vertex_span = mapped_span<GraphicsVertex>;
+    using index_span = mapped_span<GraphicsIndex>;
+
+
+    // Vertices of a part and indices into them, counted from the first vertex of the part, handed out together.
+    struct geometry_span
+    {
+        vertex_span vertices;
+        index_span indices;
+    };
+
+
+    // Draw of one part. Vertices of the buffer start at its beginning and indices at the offset; the part is
+    // indexed if it has any, and those are counted from its first vertex.
+    struct geometry_draw
+    {
+        vk::Buffer buffer;
+        vk::DeviceSize index_offset;
+
+        size_t first_vertex;
+        size_t vertex_count;
+
+        size_t first_index;
+        size_t index_count;
+    };
+
+
+    // Vertices and indices are written straight into persistently mapped upload buffers, one per frame in
+    // flight, used in turn with every taken upload. With as many uploads in between, the frames that last read
+    // an upload buffer are done before it is written again, so uploads only create Vulkan objects when they
+    // outgrow what was there and never wait for the device.
+    //
+    // Upload buffers are copied whole on the transfer queue, each to a device local geometry buffer of its own.
+    // Those are drawn from until the next taken upload, so like upload buffers they are done with before being
+    // written again and copies need no barriers against earlier frames. Copies signal a semaphore the draw of
+    // the frame that takes them waits for, so they run alongside the frames in flight instead of in line with
+    // them. On unified memory the copy buys nothing, so the upload buffers are drawn from directly instead.
+    //
+    // Geometry is written in parts, which are packed in order into chunks of at most max_chunk_size, so that no
+    // buffer runs into allocation or heap limits however much is drawn. Each chunk has its own upload and
+    // device local buffer, which double in size up to that limit when they are outgrown. A part never straddles
+    // two chunks, since its indices only address its own vertices; parts are drawn one by one with their first
+    // index and vertex offset in their chunk. Parts can be hidden, like ones outside of the view, and are then
+    // left out of the draws without being written again.
+    //
+    // Parts that didn't change since the last write can keep what was written for them instead of being handed
+    // out again. They are copied over from the buffer drawn from so far on the device when the upload is taken,
+    // along with the written parts, so that only those go through the upload buffer.
+    //
+    // All memory is sub-allocated from blocks. Uniform buffers depend on the number of swapchain images and come
+    // from linear pools, which are emptied at once when that changes.
     struct MemoryManager
     {
-        static constexpr size_t vertex_count = 50000;
-        static constexpr vk::DeviceSize vertex_buffer_offset = 0;
+        static constexpr vk::DeviceSize initial_chunk_size = vk::DeviceSize{64} << 10;
+        static constexpr vk::DeviceSize max_chunk_size = vk::DeviceSize{32} << 20;
 
-        static constexpr vk::DeviceSize buffer_size = sizeof(GraphicsVertex) * vertex_count;
+        // Parts within both limits fit a chunk. Multiples of six, so that wires and triangles drawn in order
+        // split evenly into parts.
+        static constexpr size_t max_part_vertex_count = max_chunk_size / 2 / sizeof(GraphicsVertex) / 6 * 6;
+        static constexpr size_t max_part_index_count = max_chunk_size / 2 / sizeof(GraphicsIndex) / 6 * 6;
 
 
         [[maybe_unused]] explicit MemoryManager(
                 const std::shared_ptr<const device> &device,
-                const swapchain &swapchain) :
+                const swapchain &swapchain,
+                const size_t frame_count) :
 
                 _device(device),
-
-                _vertex_buffer
-                        {
-                                _create_buffer(
-                                        vk::BufferUsageFlagBits::eVertexBuffer
-                                        | vk::BufferUsageFlagBits::eTransferDst, *device)
-                        },
-                _vertex_buffer_memory{_allocate_buffer_memory(*_vertex_buffer, *device)},
+                _allocator{*device},
+                _is_unified_memory{_allocator.is_unified_memory()},
 
                 _uniform_buffers{_create_uniform_buffers(swapchain, *device)},
-                _uniform_buffers_memory{_allocate_uniform_buffers(swapchain, *device)},
+                _uniform_buffers_memory{_allocate_uniform_buffers(swapchain)},
 
-                _transfer_command_pool{_create_transfer_command_pool(*device)}
+                _upload_buffers(frame_count),
+
+                _upload_command_pool{_create_upload_command_pool(*device)},
+                _upload_command_buffers{_allocate_upload_command_buffers(frame_count, *device)},
+                _upload_semaphores{_create_upload_semaphores(frame_count, *device)}
         {
 #if !defined(NDEBUG)
-            std::cout << "Vertex vertex_buffer created" << std::endl;
-            std::cout << "Memory bound to owned_vertex vertex_buffer" << std::endl;
+            if (_is_unified_memory) std::cout << "Unified memory, vertices aren't staged" << std::endl;
             std::cout << "Uniform buffers created" << std::endl;
             std::cout << "Memory bound to uniform buffers" << std::endl;
             std::cout << std::endl << "-- Memory manager done --" << std::endl << std::endl;
@@ -92,9 +239,77 @@ namespace il
         }
 
 
-        [[nodiscard]] const vk::Buffer &vertex_buffer() const
+        [[nodiscard]] bool is_unified_memory() const
+        {
+            return _is_unified_memory;
+        }
+
+        // Draws of the visible parts as of the last taken upload which have anything to draw, in order.
+        [[nodiscard]] std::vector<geometry_draw> get_geometry_draws() const
+        {
+            std::vector<geometry_draw> result{ };
+            if (!_drawn_upload_index.has_value()) return result;
+
+            const auto &upload = _upload_buffers[_drawn_upload_index.value()];
+            for (size_t i = 0 ; i < _drawn_layout.parts.size() ; ++i)
+            {
+                const auto &part = _drawn_layout.parts[i];
+                if (part.counts.vertex_count == 0 || !_drawn_layout.is_visible(i)) continue;
+
+                const auto &chunk = upload.chunks[part.chunk];
+                const auto &buffer = _is_unified_memory ? chunk.geometry.buffer : chunk.device_local_geometry.buffer;
+
+                result.emplace_back(
+                        geometry_draw
+                                {
+                                        *buffer,
+                                        _get_index_offset(_drawn_layout.chunks[part.chunk].vertex_count),
+                                        part.first_vertex,
+                                        part.counts.vertex_count,
+                                        part.first_index,
+                                        part.counts.index_count
+                                });
+            }
+
+            return result;
+        }
+
+        // Changes with every taken upload and with every change of which drawn parts are visible, so that draw
+        // commands know when to be recorded again.
+        [[nodiscard]] size_t draw_generation() const
+        {
+            return _draw_generation;
+        }
+
+        // Whether each part of the last written geometry is drawn, in order. Parts past the end are. Geometry
+        // written afterwards is all visible again until this is set for it.
+        void set_part_visibility(std::vector<bool> visible_parts)
+        {
+            if (_pending_layout.has_value())
+            {
+                _pending_layout->visible_parts = std::move(visible_parts);
+                return;
+            }
+
+            if (_drawn_layout.visible_parts == visible_parts) return;
+
+            _drawn_layout.visible_parts = std::move(visible_parts);
+            ++_draw_generation;
+        }
+
+        [[nodiscard]] size_t uniform_buffer_count() const
         {
-            return *_vertex_buffer;
+            return _uniform_buffers.size();
+        }
+
+        [[nodiscard]] const vk::Buffer &uniform_buffer(const size_t image_index) const
+        {
+            return *_uniform_buffers[image_index];
+        }
+
+        [[nodiscard]] std::vector<memory_type_usage> get_memory_usage() const
+        {
+            return _allocator.get_usage();
         }
 
         [[maybe_unused]] void switch_device(const std::shared_ptr<device> &new_device)
@@ -102,133 +317,480 @@ namespace il
             _device = new_device;
         }
 
+        // Uniform buffers only depend on the number of swapchain images, so they are kept if that stays.
         void reconstruct(const swapchain &swapchain)
         {
+            if (_uniform_buffers.size() == swapchain.get_configuration_view().image_count) return;
+
             const auto shared_device = _get_shared_device();
             const auto &device = *shared_device;
 
+            _uniform_buffers.clear();
+            _uniform_buffers_memory.clear();
+            _allocator.reset_linear_pools();
+
             _uniform_buffers = _create_uniform_buffers(swapchain, device);
-            _uniform_buffers_memory = _allocate_uniform_buffers(swapchain, device);
+            _uniform_buffers_memory = _allocate_uniform_buffers(swapchain);
 
 #if !defined(NDEBUG)
             std::cout << "Uniform buffers created" << std::endl;
             std::cout << "Memory bound to uniform buffers" << std::endl;
+            for (const auto &usage : get_memory_usage())
+                std::cout << "Memory type " << usage.memory_type_index << ": " <<
+                          usage.used << " of " << usage.reserved << " bytes used by " <<
+                          usage.allocation_count << " allocations in " << usage.block_count << " blocks" << std::endl;
             std::cout << std::endl << "-- Memory manager reconstructed --" << std::endl << std::endl;
 #endif
         }
 
 
-        void set_vertex_buffer(std::vector<GraphicsVertex> vertices) const
+        // Hands out the next upload buffer for the parts, which replace the drawn ones once the upload is taken.
+        // Indices of every three make a triangle, without any the vertices do. Each part has to be within
+        // max_part_vertex_count and max_part_index_count. The frame one more than the frames in flight back has
+        // to be done.
+        [[nodiscard]] std::vector<geometry_span> write_geometry(const std::vector<geometry_counts> &parts)
+        {
+            std::vector<geometry_span> result{ };
+            result.reserve(parts.size());
+
+            for (const auto &span : write_geometry(parts, { })) result.emplace_back(span.value());
+
+            return result;
+        }
+
+        // Like write_geometry, but each part with a kept part, which is an index into the last written parts,
+        // keeps what was written for that one instead of being handed out. Parts that can't keep it are handed
+        // out like the others: ones whose counts differ from those of their kept part, and ones whose kept part
+        // was handed out itself since the last taken upload, which it isn't copied from.
+        [[nodiscard]] std::vector<std::optional<geometry_span>> write_geometry(
+                const std::vector<geometry_counts> &parts, const std::vector<std::optional<size_t>> &kept_parts)
         {
             const auto shared_device = _get_shared_device();
             const auto &device = *shared_device;
 
-            auto staging_buffer{
-                    _create_buffer(vk::BufferUsageFlagBits::eTransferSrc, device)};
-            auto staging_buffer_memory{
-                    _allocate_buffer_memory(*staging_buffer, device)};
-            device->bindBufferMemory(*staging_buffer, *staging_buffer_memory, 0);
+            auto layout = _get_layout(parts);
+            for (size_t i = 0 ; i < parts.size() && i < kept_parts.size() ; ++i)
+                layout.kept_geometry[i] = _find_kept_geometry(kept_parts[i], parts[i]);
+
+            auto &upload = _upload_buffers[_get_next_upload_index()];
+            if (upload.chunks.size() < layout.chunks.size()) upload.chunks.resize(layout.chunks.size());
+
+            for (size_t i = 0 ; i < layout.chunks.size() ; ++i)
+            {
+                auto &chunk = upload.chunks[i];
+
+                const auto size = _get_geometry_size(layout.chunks[i]);
+                if (size <= chunk.geometry.capacity) continue;
+
+                // Old ones go first, so that their memory can be reused.
+                const auto capacity = std::min(
+                        std::max({size, 2 * chunk.geometry.capacity, initial_chunk_size}), max_chunk_size);
+                chunk = geometry_chunk{ };
+
+                chunk.geometry = _create_geometry_buffer(
+                        capacity,
+                        vk::BufferUsageFlagBits::eTransferSrc
+                        | vk::BufferUsageFlagBits::eTransferDst
+                        | vk::BufferUsageFlagBits::eVertexBuffer
+                        | vk::BufferUsageFlagBits::eIndexBuffer,
+                        memory_class::host_dynamic,
+                        device);
+
+                if (!_is_unified_memory)
+                    chunk.device_local_geometry = _create_geometry_buffer(
+                            capacity,
+                            vk::BufferUsageFlagBits::eTransferSrc
+                            | vk::BufferUsageFlagBits::eTransferDst
+                            | vk::BufferUsageFlagBits::eVertexBuffer
+                            | vk::BufferUsageFlagBits::eIndexBuffer,
+                            memory_class::device_static,
+                            device);
+            }
+
+            std::vector<std::optional<geometry_span>> result(layout.parts.size());
+
+            for (size_t i = 0 ; i < layout.parts.size() ; ++i)
+            {
+                if (layout.kept_geometry[i].has_value()) continue;
+
+                const auto &part = layout.parts[i];
+                auto *const mapping = static_cast<std::byte *>(upload.chunks[part.chunk].geometry.memory.mapping());
+                const auto index_offset = _get_index_offset(layout.chunks[part.chunk].vertex_count);
+
+                result[i].emplace(
+                        geometry_span
+                                {
+                                        vertex_span
+                                                {
+                                                        mapping ?
+                                                        reinterpret_cast<GraphicsVertex *>(mapping) +
+                                                        part.first_vertex :
+                                                        nullptr,
+                                                        part.counts.vertex_count
+                                                },
+                                        index_span
+                                                {
+                                                        mapping ?
+                                                        reinterpret_cast<GraphicsIndex *>(mapping + index_offset) +
+                                                        part.first_index :
+                                                        nullptr,
+                                                        part.counts.index_count
+                                                }
+                                });
+            }
 
-            vertices.resize(vertex_count);
+            _pending_layout = std::move(layout);
 
-            std::memcpy(
-                    device->mapMemory(*staging_buffer_memory, vertex_buffer_offset, buffer_size, { }),
-                    vertices.data(),
-                    buffer_size);
-            device->unmapMemory(*staging_buffer_memory);
+            return result;
+        }
 
-            _copy_buffer(*_vertex_buffer, *staging_buffer);
+        // Like write_geometry, for a single part.
+        [[nodiscard]] geometry_span write_geometry(const size_t vertex_count, const size_t index_count)
+        {
+            return write_geometry(std::vector<geometry_counts>{geometry_counts{vertex_count, index_count}}).front();
         }
 
+        // Vertices of a single part drawn in order, three to a triangle.
+        [[nodiscard]] vertex_span write_vertices(const size_t count)
+        {
+            return write_geometry(count, 0).vertices;
+        }
 
-    private:
-        void _copy_buffer(const vk::Buffer &destination, const vk::Buffer &source) const
+        // Takes the written geometry, if there is any, for the frame, which draws it first. Submits the copies
+        // of kept parts and, unless memory is unified, of written parts to the device local geometry buffer to
+        // the transfer queue and returns the semaphore they signal. The draw commands of the frame have to wait
+        // for it at the vertex input stage, which also keeps the command buffer and the semaphore of the frame
+        // from being reused before the copies are done.
+        [[nodiscard]] std::optional<vk::Semaphore> take_geometry_upload(const size_t frame)
         {
+            if (!_pending_layout.has_value()) return std::nullopt;
+
+            const auto kept_upload_index = _drawn_upload_index;
+            const auto upload_index = _get_next_upload_index();
+
+            _drawn_upload_index = upload_index;
+            _drawn_layout = std::move(_pending_layout.value());
+            _pending_layout.reset();
+            ++_draw_generation;
+
+            const auto copies = _get_geometry_copies(kept_upload_index, upload_index);
+            _drawn_layout.kept_geometry.clear();
+
+            if (_is_unified_memory && copies.empty()) return std::nullopt;
+
             const auto shared_device = _get_shared_device();
             const auto &device = *shared_device;
 
-            auto transfer_command_buffer
-                    {
-                            std::move(
-                                    device->allocateCommandBuffersUnique(
-                                            {
-                                                    *_transfer_command_pool,
-                                                    vk::CommandBufferLevel::ePrimary,
-                                                    1
-                                            })[0])
-                    };
+            const auto &command_buffer = *_upload_command_buffers[frame];
+            const auto &semaphore = *_upload_semaphores[frame];
 
-            transfer_command_buffer->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+            command_buffer.reset({ });
+            command_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
 
-            transfer_command_buffer->copyBuffer(
-                    source, destination,
-                    {
-                            {
-                                    0,
-                                    0,
-                                    buffer_size
-                            }
-                    });
-
-            transfer_command_buffer->end();
+            for (const auto &copy : copies) command_buffer.copyBuffer(copy.source, copy.destination, {copy.region});
 
-            const auto transfer_command_fence =
-                    device->createFenceUnique({ });
+            command_buffer.end();
 
+            // Waiting on the semaphore makes the copied geometry visible to the draw, and buffers are shared
+            // between the queue families, so no ownership has to change hands either.
             device.transfer_queue.submit(
                     {
-                            {
-                                    0,
-                                    nullptr,
-                                    nullptr,
-                                    1,
-                                    &*transfer_command_buffer,
-                                    0,
-                                    nullptr
-                            }
+                            vk::SubmitInfo
+                                    {
+                                            0,
+                                            nullptr,
+                                            nullptr,
+                                            1,
+                                            &command_buffer,
+                                            1,
+                                            &semaphore
+                                    }
                     },
-                    *transfer_command_fence);
+                    nullptr);
 
-            auto wait_result = vk::Result::eSuccess;
-            try
+            return semaphore;
+        }
+
+        // The uniform buffer of an image must not be in use by the device, so the fence of the last frame
+        // drawn to it has to be waited for first.
+        void set_uniforms(const size_t image_index, const frame_uniforms &uniforms) const
+        {
+            _write_uniforms(_uniform_buffers_memory[image_index], uniforms);
+        }
+
+
+    private:
+        // Vertices of all parts in a chunk followed by their indices, laid out the same in upload buffers and
+        // the ones drawn from.
+        struct geometry_buffer
+        {
+            vk::UniqueBuffer buffer{ };
+            memory_allocation memory{ };
+
+            vk::DeviceSize capacity{0};
+        };
+
+        struct geometry_chunk
+        {
+            geometry_buffer geometry{ };
+
+            // Copy of the geometry drawn from, unless memory is unified.
+            geometry_buffer device_local_geometry{ };
+        };
+
+        struct upload_buffer
+        {
+            std::vector<geometry_chunk> chunks{ };
+        };
+
+        // Where a part is in its chunk.
+        struct part_placement
+        {
+            size_t chunk;
+            size_t first_vertex;
+            size_t first_index;
+
+            geometry_counts counts;
+        };
+
+        // Where the vertices and indices a part keeps are in a chunk of the buffer drawn from, in bytes.
+        struct kept_placement
+        {
+            size_t chunk;
+            vk::DeviceSize vertex_offset;
+            vk::DeviceSize index_offset;
+        };
+
+        struct geometry_layout
+        {
+            std::vector<part_placement> parts{ };
+
+            // Of all parts in each chunk.
+            std::vector<geometry_counts> chunks{ };
+
+            // Of every part until the upload is taken, nothing for ones that are handed out. Kept ones are in
+            // the upload buffer drawn from when they were written.
+            std::vector<std::optional<kept_placement>> kept_geometry{ };
+
+            std::vector<bool> visible_parts{ };
+
+
+            [[nodiscard]] bool is_visible(const size_t part) const
             {
-                wait_result = device->waitForFences(
-                        1,
-                        &*transfer_command_fence,
-                        VK_TRUE,
-                        UINT64_MAX);
+                return part >= visible_parts.size() || visible_parts[part];
             }
-            catch (const vk::SystemError &)
+        };
+
+
+        std::weak_ptr<const device> _device;
+
+        // Declared before everything allocated from it, so that it goes last.
+        device_memory_allocator _allocator;
+        const bool _is_unified_memory;
+
+        std::optional<size_t> _drawn_upload_index{ };
+        geometry_layout _drawn_layout{ };
+        size_t _draw_generation{0};
+
+        std::vector<vk::UniqueBuffer> _uniform_buffers;
+        std::vector<memory_allocation> _uniform_buffers_memory;
+
+        std::vector<upload_buffer> _upload_buffers;
+        std::optional<geometry_layout> _pending_layout{ };
+
+        const vk::UniqueCommandPool _upload_command_pool;
+        const std::vector<vk::UniqueCommandBuffer> _upload_command_buffers;
+        const std::vector<vk::UniqueSemaphore> _upload_semaphores;
+
+
+        // One region of a buffer copied to another, in bytes.
+        struct geometry_copy
+        {
+            vk::Buffer source;
+            vk::Buffer destination;
+            vk::BufferCopy region;
+        };
+
+
+        [[nodiscard]] size_t _get_next_upload_index() const
+        {
+            return _drawn_upload_index.has_value() ? (_drawn_upload_index.value() + 1) % _upload_buffers.size() : 0;
+        }
+
+        // Of the part of the last written geometry, which is either still to be taken or drawn, if the part with
+        // the counts can keep it.
+        [[nodiscard]] std::optional<kept_placement> _find_kept_geometry(
+                const std::optional<size_t> &kept_part, const geometry_counts &counts) const
+        {
+            // Upload buffers that are written again can't keep anything from themselves.
+            if (!kept_part.has_value() || !_drawn_upload_index.has_value() ||
+                _get_next_upload_index() == _drawn_upload_index.value())
+                return std::nullopt;
+
+            const auto &layout = _pending_layout.has_value() ? _pending_layout.value() : _drawn_layout;
+            if (kept_part.value() >= layout.parts.size()) return std::nullopt;
+
+            const auto &part = layout.parts[kept_part.value()];
+            if (part.counts.vertex_count != counts.vertex_count || part.counts.index_count != counts.index_count)
+                return std::nullopt;
+
+            if (_pending_layout.has_value()) return layout.kept_geometry[kept_part.value()];
+
+            return kept_placement
+                    {
+                            part.chunk,
+                            part.first_vertex * sizeof(GraphicsVertex),
+                            _get_index_offset(layout.chunks[part.chunk].vertex_count) +
+                            part.first_index * sizeof(GraphicsIndex)
+                    };
+        }
+
+        // Of the kept parts of the drawn geometry from the buffer drawn from before and, unless memory is unified,
+        // of its written parts from the upload buffer to the device local one. Vertices of consecutive parts and
+        // then their indices are next to each other in both, so those are copied together.
+        [[nodiscard]] std::vector<geometry_copy> _get_geometry_copies(
+                const std::optional<size_t> &kept_upload_index, const size_t upload_index) const
+        {
+            const auto drawn_buffer = [this](const upload_buffer &upload, const size_t chunk)
             {
-                // Do something meaningful.
-                device.transfer_queue.waitIdle();
-            }
-            if (wait_result == vk::Result::eTimeout)
+                const auto &geometry = upload.chunks[chunk];
+                return _is_unified_memory ? *geometry.geometry.buffer : *geometry.device_local_geometry.buffer;
+            };
+
+            const auto &upload = _upload_buffers[upload_index];
+
+            std::vector<geometry_copy> result{ };
+            const auto add = [&result](const vk::Buffer &source, const vk::Buffer &destination,
+                                       const vk::DeviceSize source_offset, const vk::DeviceSize destination_offset,
+                                       const vk::DeviceSize size)
             {
-                device.transfer_queue.waitIdle();
+                if (size == 0) return;
+
+                if (!result.empty())
+                {
+                    auto &last = result.back();
+                    if (last.source == source && last.destination == destination &&
+                        last.region.srcOffset + last.region.size == source_offset &&
+                        last.region.dstOffset + last.region.size == destination_offset)
+                    {
+                        last.region.size += size;
+                        return;
+                    }
+                }
+
+                result.emplace_back(geometry_copy{source, destination, {source_offset, destination_offset, size}});
+            };
+
+            for (const auto is_index_copy : {false, true})
+            {
+                for (size_t i = 0 ; i < _drawn_layout.parts.size() ; ++i)
+                {
+                    const auto &part = _drawn_layout.parts[i];
+                    const auto &kept = _drawn_layout.kept_geometry[i];
+
+                    const auto offset = is_index_copy ?
+                                        _get_index_offset(_drawn_layout.chunks[part.chunk].vertex_count) +
+                                        part.first_index * sizeof(GraphicsIndex) :
+                                        part.first_vertex * sizeof(GraphicsVertex);
+                    const auto size = is_index_copy ?
+                                      part.counts.index_count * sizeof(GraphicsIndex) :
+                                      part.counts.vertex_count * sizeof(GraphicsVertex);
+
+                    if (kept.has_value())
+                        add(
+                                drawn_buffer(_upload_buffers[kept_upload_index.value()], kept->chunk),
+                                drawn_buffer(upload, part.chunk),
+                                is_index_copy ? kept->index_offset : kept->vertex_offset,
+                                offset,
+                                size);
+                    else if (!_is_unified_memory)
+                        add(
+                                *upload.chunks[part.chunk].geometry.buffer,
+                                *upload.chunks[part.chunk].device_local_geometry.buffer,
+                                offset,
+                                offset,
+                                size);
+                }
             }
+
+            return result;
         }
 
 
-        std::weak_ptr<const device> _device;
+        [[nodiscard]] static vk::DeviceSize _get_index_offset(const size_t vertex_count)
+        {
+            return vertex_count * sizeof(GraphicsVertex);
+        }
 
-        const vk::UniqueBuffer _vertex_buffer;
-        const vk::UniqueDeviceMemory _vertex_buffer_memory;
+        [[nodiscard]] static vk::DeviceSize _get_geometry_size(const geometry_counts &counts)
+        {
+            return _get_index_offset(counts.vertex_count) + counts.index_count * sizeof(GraphicsIndex);
+        }
 
-        std::vector<vk::UniqueBuffer> _uniform_buffers;
-        std::vector<vk::UniqueDeviceMemory> _uniform_buffers_memory;
+        // Packs the parts in order, starting a new chunk whenever the next part doesn't fit the last one.
+        [[nodiscard]] static geometry_layout _get_layout(const std::vector<geometry_counts> &parts)
+        {
+            geometry_layout result{ };
+            result.parts.reserve(parts.size());
+            result.kept_geometry.resize(parts.size());
+
+            for (const auto &part : parts)
+            {
+                if (part.vertex_count > max_part_vertex_count || part.index_count > max_part_index_count)
+                {
+                    throw std::length_error("Geometry part exceeds the part limits of the memory manager.");
+                }
 
-        const vk::UniqueCommandPool _transfer_command_pool;
+                if (result.chunks.empty() ||
+                    _get_geometry_size(result.chunks.back()) + _get_geometry_size(part) > max_chunk_size)
+                    result.chunks.emplace_back();
+
+                auto &chunk = result.chunks.back();
+                result.parts.emplace_back(
+                        part_placement
+                                {
+                                        result.chunks.size() - 1,
+                                        chunk.vertex_count,
+                                        chunk.index_count,
+                                        part
+                                });
+
+                chunk.vertex_count += part.vertex_count;
+                chunk.index_count += part.index_count;
+            }
+
+            return result;
+        }
+
+        [[nodiscard]] geometry_buffer _create_geometry_buffer(
+                const vk::DeviceSize capacity,
+                const vk::BufferUsageFlags &usage,
+                const memory_class memory_class,
+                const device &device)
+        {
+            geometry_buffer result{ };
+
+            result.buffer = _create_buffer(capacity, usage, device);
+            result.memory = _allocate_buffer_memory(*result.buffer, memory_class);
+            result.capacity = capacity;
+
+#if !defined(NDEBUG)
+            std::cout << "Geometry buffer of " << capacity << " bytes created" << std::endl;
+#endif
+
+            return result;
+        }
 
 
         [[nodiscard]] static vk::UniqueBuffer _create_buffer(
+                const vk::DeviceSize size,
                 const vk::BufferUsageFlags &usage,
                 const device &device)
         {
             vk::BufferCreateInfo create_info =
                     {
                             { },
-                            buffer_size,
+                            size,
                             usage,
                             vk::SharingMode::eExclusive
                     };
@@ -258,73 +820,70 @@ namespace il
         {
             std::vector<vk::UniqueBuffer> result{0};
             for (unsigned int i = 0 ; i < swapchain.get_configuration_view().image_count ; ++i)
-                result.emplace_back(_create_buffer(vk::BufferUsageFlagBits::eUniformBuffer, device));
+                result.emplace_back(
+                        _create_buffer(sizeof(frame_uniforms), vk::BufferUsageFlagBits::eUniformBuffer, device));
 
             return result;
         }
 
-        [[nodiscard]] static vk::UniqueDeviceMemory _allocate_buffer_memory(
+        [[nodiscard]] memory_allocation _allocate_buffer_memory(
                 const vk::Buffer &buffer,
-                const device &device)
+                const memory_class memory_class,
+                const memory_pool_kind kind = memory_pool_kind::free_list)
         {
-            const auto &memory_requirements = device->getBufferMemoryRequirements(buffer);
-
-            auto result = device->allocateMemoryUnique(
-                    {
-                            memory_requirements.size,
-                            _select_memory_type_index(
-                                    memory_requirements,
-                                    vk::MemoryPropertyFlagBits::eHostVisible |
-                                    vk::MemoryPropertyFlagBits::eHostCoherent,
-                                    device)
-                    });
-
-            device->bindBufferMemory(buffer, *result, 0);
-
-            return result;
+            return _allocator.allocate_for(buffer, memory_class, kind);
         }
 
-        [[nodiscard]] std::vector<vk::UniqueDeviceMemory> _allocate_uniform_buffers(
-                const swapchain &swapchain,
-                const device &device) const
+        [[nodiscard]] std::vector<memory_allocation> _allocate_uniform_buffers(const swapchain &swapchain)
         {
-            std::vector<vk::UniqueDeviceMemory> result{0};
+            std::vector<memory_allocation> result{ };
             for (unsigned int i = 0 ; i < swapchain.get_configuration_view().image_count ; ++i)
-                result.emplace_back(_allocate_buffer_memory(*_uniform_buffers[i], device));
+            {
+                result.emplace_back(_allocate_buffer_memory(*_uniform_buffers[i], memory_class::host_dynamic, memory_pool_kind::linear));
+                _write_uniforms(result.back(), frame_uniforms{ });
+            }
 
             return result;
         }
 
-        [[nodiscard]] static unsigned int _select_memory_type_index(
-                const vk::MemoryRequirements &memory_requirements,
-                const vk::MemoryPropertyFlags &properties,
-                const device &device)
+        static void _write_uniforms(const memory_allocation &memory, const frame_uniforms &uniforms)
         {
-            const auto physical_memory_properties = device.physical().getMemoryProperties();
-
-            for (unsigned int i = 0 ; i < physical_memory_properties.memoryTypeCount ; ++i)
-            {
-                if (memory_requirements.memoryTypeBits & 1 << i &&
-                    (physical_memory_properties.memoryTypes[i].propertyFlags & properties) ==
-                    properties)
-                {
-                    return i;
-                }
-            }
-
-            throw std::runtime_error("Failed to find suitable memory type");
+            std::memcpy(memory.mapping(), &uniforms, sizeof(frame_uniforms));
         }
 
-        [[nodiscard]] static vk::UniqueCommandPool _create_transfer_command_pool(
+        [[nodiscard]] static vk::UniqueCommandPool _create_upload_command_pool(
                 const device &device)
         {
             return device->createCommandPoolUnique(
                     {
-                            vk::CommandPoolCreateFlagBits::eTransient,
+                            vk::CommandPoolCreateFlagBits::eTransient
+                            | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
                             device.queue_family_indices.transfer_family.value()
                     });
         }
 
+        [[nodiscard]] std::vector<vk::UniqueCommandBuffer> _allocate_upload_command_buffers(
+                const size_t frame_count,
+                const device &device) const
+        {
+            return device->allocateCommandBuffersUnique(
+                    {
+                            *_upload_command_pool,
+                            vk::CommandBufferLevel::ePrimary,
+                            static_cast<unsigned int>(frame_count)
+                    });
+        }
+
+        [[nodiscard]] static std::vector<vk::UniqueSemaphore> _create_upload_semaphores(
+                const size_t frame_count,
+                const device &device)
+        {
+            std::vector<vk::UniqueSemaphore> result{ };
+            for (size_t i = 0 ; i < frame_count ; ++i) result.emplace_back(device->createSemaphoreUnique({ }));
+
+            return result;
+        }
+
 
         [[nodiscard]] std::shared_ptr<const device> _get_shared_device() const
         {
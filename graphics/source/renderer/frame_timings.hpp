@@ -0,0 +1,270 @@
+#ifndef GRAPHICS_FRAME_TIMINGS_HPP
+#define GRAPHICS_FRAME_TIMINGS_HPP
+
+
+#include "../external/pch.hpp"
+
+#include "../environment/device.hpp"
+
+
+namespace il
+{
+	// Parts of a frame that are timed. All but the render pass are spans of the CPU thread drawing the frame.
+	enum class frame_stage
+	{
+		fence_wait,
+		acquire,
+		record,
+		submit,
+		present,
+		// Time the device took from the start to the end of the render pass.
+		gpu_render_pass
+	};
+
+	static constexpr size_t frame_stage_count = 6;
+
+	[[nodiscard]] inline const char* to_string(const frame_stage stage)
+	{
+		switch (stage)
+		{
+		case frame_stage::fence_wait: return "fence_wait";
+		case frame_stage::acquire: return "acquire";
+		case frame_stage::record: return "record";
+		case frame_stage::submit: return "submit";
+		case frame_stage::present: return "present";
+		case frame_stage::gpu_render_pass: return "gpu_render_pass";
+		}
+
+		return "unknown";
+	}
+
+
+	struct duration_statistics
+	{
+		std::chrono::nanoseconds minimum{};
+		std::chrono::nanoseconds average{};
+		std::chrono::nanoseconds p99{};
+
+		size_t sample_count = 0;
+	};
+
+
+	// Statistics over the last window_size samples, so that they follow changes instead of averaging them away.
+	struct rolling_durations
+	{
+		static constexpr size_t window_size = 512;
+
+		void add(const std::chrono::nanoseconds duration)
+		{
+			samples_[next_ % window_size] = duration;
+			++next_;
+		}
+
+		[[nodiscard]] duration_statistics get_statistics() const
+		{
+			const auto count = std::min(next_, window_size);
+			if (count == 0) return {};
+
+			std::vector<std::chrono::nanoseconds> sorted{ samples_.begin(), samples_.begin() + count };
+			std::sort(sorted.begin(), sorted.end());
+
+			// Nearest rank, the smallest sample that at least 99% of them don't exceed.
+			const auto p99_rank = (count * 99 + 99) / 100;
+
+			return
+			{
+				sorted.front(),
+				std::accumulate(sorted.begin(), sorted.end(), std::chrono::nanoseconds{}) /
+					static_cast<std::chrono::nanoseconds::rep>(count),
+				sorted[p99_rank - 1],
+				count
+			};
+		}
+
+	private:
+		std::array<std::chrono::nanoseconds, window_size> samples_{};
+		size_t next_ = 0;
+	};
+
+
+	// Rolling statistics of every frame stage.
+	struct frame_timings
+	{
+		using clock = std::chrono::steady_clock;
+
+
+		// Adds the time from its construction to its destruction to the stage, even if it is left by an exception.
+		struct span
+		{
+			span(frame_timings& timings, const frame_stage stage) :
+				timings_{ timings },
+				stage_{ stage },
+				start_{ clock::now() } { }
+
+			span(const span&) = delete;
+			span& operator=(const span&) = delete;
+
+			~span()
+			{
+				timings_.add(stage_, clock::now() - start_);
+			}
+
+		private:
+			frame_timings& timings_;
+			const frame_stage stage_;
+			const clock::time_point start_;
+		};
+
+
+		void add(const frame_stage stage, const std::chrono::nanoseconds duration)
+		{
+			stages_[static_cast<size_t>(stage)].add(duration);
+		}
+
+		[[nodiscard]] duration_statistics get_statistics(const frame_stage stage) const
+		{
+			return stages_[static_cast<size_t>(stage)].get_statistics();
+		}
+
+		// One line per stage, with durations in microseconds.
+		void write_csv(std::ostream& output) const
+		{
+			output << "stage,samples,min_us,avg_us,p99_us\n";
+
+			for (size_t i = 0; i < frame_stage_count; ++i)
+			{
+				const auto stage = static_cast<frame_stage>(i);
+				const auto statistics = get_statistics(stage);
+
+				output << to_string(stage) << ',' << statistics.sample_count << ',' <<
+					to_microseconds(statistics.minimum) << ',' <<
+					to_microseconds(statistics.average) << ',' <<
+					to_microseconds(statistics.p99) << '\n';
+			}
+		}
+
+		void write_csv(const std::string& path) const
+		{
+			std::ofstream file{ path, std::ios::trunc };
+			if (!file.is_open())
+			{
+				throw std::runtime_error("Failed to open file from path '" + path + "'.");
+			}
+
+			write_csv(file);
+			if (!file)
+			{
+				throw std::runtime_error("Failed to write file at '" + path + "'.");
+			}
+		}
+
+	private:
+		std::array<rolling_durations, frame_stage_count> stages_{};
+
+		[[nodiscard]] static double to_microseconds(const std::chrono::nanoseconds duration)
+		{
+			return std::chrono::duration<double, std::micro>{ duration }.count();
+		}
+	};
+
+
+	// Timestamps written by the device around the render pass of each frame slot, which are read back once the
+	// fence of the slot says the frame is done. Devices whose graphics queue can't write timestamps get no
+	// queries and report no times.
+	struct render_pass_timestamps
+	{
+		render_pass_timestamps(const device& device, const size_t frame_count) :
+			valid_bit_mask_{ get_valid_bit_mask(device) },
+			nanoseconds_per_tick_{ device.physical().getProperties().limits.timestampPeriod },
+			query_pool_{ create_query_pool(device, frame_count) },
+			is_written_(frame_count, false) { }
+
+		// Outside of the render pass, before it begins.
+		void write_begin(const vk::CommandBuffer& command_buffer, const size_t frame) const
+		{
+			if (!query_pool_) return;
+
+			command_buffer.resetQueryPool(*query_pool_, first_query(frame), 2);
+			command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *query_pool_, first_query(frame));
+		}
+
+		// Outside of the render pass, after it ended.
+		void write_end(const vk::CommandBuffer& command_buffer, const size_t frame)
+		{
+			if (!query_pool_) return;
+
+			command_buffer.writeTimestamp(
+				vk::PipelineStageFlagBits::eBottomOfPipe, *query_pool_, first_query(frame) + 1);
+			is_written_[frame] = true;
+		}
+
+		// The fence of the frame slot has to be waited for first. Each recorded frame is read only once.
+		[[nodiscard]] std::optional<std::chrono::nanoseconds> read(const device& device, const size_t frame)
+		{
+			if (!query_pool_ || !is_written_[frame]) return std::nullopt;
+			is_written_[frame] = false;
+
+			std::array<std::uint64_t, 2> ticks{};
+			const auto result = device->getQueryPoolResults(
+				*query_pool_,
+				first_query(frame),
+				2,
+				sizeof(ticks),
+				ticks.data(),
+				sizeof(std::uint64_t),
+				vk::QueryResultFlagBits::e64);
+
+			if (result != vk::Result::eSuccess) return std::nullopt;
+
+			const auto elapsed_ticks = (ticks[1] - ticks[0]) & valid_bit_mask_;
+			return std::chrono::nanoseconds
+			{
+				static_cast<std::chrono::nanoseconds::rep>(
+					static_cast<double>(elapsed_ticks) * static_cast<double>(nanoseconds_per_tick_))
+			};
+		}
+
+	private:
+		const std::uint64_t valid_bit_mask_;
+		const float nanoseconds_per_tick_;
+		const vk::UniqueQueryPool query_pool_;
+
+		std::vector<bool> is_written_;
+
+
+		[[nodiscard]] static std::uint32_t first_query(const size_t frame)
+		{
+			return static_cast<std::uint32_t>(2 * frame);
+		}
+
+		[[nodiscard]] static std::uint64_t get_valid_bit_mask(const device& device)
+		{
+			const auto valid_bits = device.physical().getQueueFamilyProperties()
+				[device.queue_family_indices.graphics_family.value()].timestampValidBits;
+
+			return valid_bits >= 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << valid_bits) - 1;
+		}
+
+		[[nodiscard]] vk::UniqueQueryPool create_query_pool(const device& device, const size_t frame_count) const
+		{
+			if (valid_bit_mask_ == 0) return {};
+
+			auto result = device->createQueryPoolUnique(
+				{
+					{},
+					vk::QueryType::eTimestamp,
+					static_cast<unsigned int>(2 * frame_count),
+					{}
+				});
+
+#if !defined(NDEBUG)
+			std::cout << "Timestamp query pool created" << std::endl;
+#endif
+
+			return result;
+		}
+	};
+}
+
+
+#endif
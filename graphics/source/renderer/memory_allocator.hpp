@@ -0,0 +1,601 @@
+#ifndef IRGLAB_MEMORY_ALLOCATOR_HPP
+#define IRGLAB_MEMORY_ALLOCATOR_HPP
+
+
+#include "../external/pch.hpp"
+
+#include "../environment/device.hpp"
+
+
+namespace il
+{
+    [[nodiscard]] constexpr vk::DeviceSize align_up(const vk::DeviceSize offset, const vk::DeviceSize alignment) noexcept
+    {
+        return alignment > 1 ? (offset + alignment - 1) / alignment * alignment : offset;
+    }
+
+
+    // Offsets within a block of memory handed out first fit. Free runs are kept sorted by offset and merged
+    // with their neighbours when released, so the block doesn't fragment into runs nothing fits in.
+    class free_list_range
+    {
+    public:
+        explicit free_list_range(const vk::DeviceSize size) :
+                _free_runs{run{0, size}},
+                _size{size}
+        { }
+
+
+        [[nodiscard]] vk::DeviceSize size() const noexcept
+        {
+            return _size;
+        }
+
+        [[nodiscard]] vk::DeviceSize used() const noexcept
+        {
+            return _used;
+        }
+
+        [[nodiscard]] bool is_empty() const noexcept
+        {
+            return _used == 0;
+        }
+
+
+        // Padding in front of an aligned offset stays free.
+        [[nodiscard]] std::optional<vk::DeviceSize> allocate(const vk::DeviceSize size, const vk::DeviceSize alignment)
+        {
+            for (auto current = _free_runs.begin() ; current != _free_runs.end() ; ++current)
+            {
+                const auto offset = align_up(current->offset, alignment);
+                const auto end = offset + size;
+                const auto run_end = current->offset + current->size;
+                if (end > run_end) continue;
+
+                if (offset == current->offset)
+                {
+                    if (end == run_end) _free_runs.erase(current);
+                    else *current = run{end, run_end - end};
+                }
+                else
+                {
+                    current->size = offset - current->offset;
+                    if (end < run_end) _free_runs.insert(std::next(current), run{end, run_end - end});
+                }
+
+                _used += size;
+                return offset;
+            }
+
+            return std::nullopt;
+        }
+
+        void release(const vk::DeviceSize offset, const vk::DeviceSize size)
+        {
+            auto next = std::lower_bound(
+                    _free_runs.begin(), _free_runs.end(), offset,
+                    [](const run &free_run, const vk::DeviceSize value)
+                    {
+                        return free_run.offset < value;
+                    });
+
+            if (next != _free_runs.begin() && std::prev(next)->offset + std::prev(next)->size == offset)
+            {
+                auto previous = std::prev(next);
+                previous->size += size;
+
+                if (next != _free_runs.end() && previous->offset + previous->size == next->offset)
+                {
+                    previous->size += next->size;
+                    _free_runs.erase(next);
+                }
+            }
+            else if (next != _free_runs.end() && offset + size == next->offset)
+            {
+                next->offset = offset;
+                next->size += size;
+            }
+            else
+            {
+                _free_runs.insert(next, run{offset, size});
+            }
+
+            _used -= size;
+        }
+
+
+    private:
+        struct run
+        {
+            vk::DeviceSize offset;
+            vk::DeviceSize size;
+        };
+
+
+        std::vector<run> _free_runs;
+
+        vk::DeviceSize _size;
+        vk::DeviceSize _used{0};
+    };
+
+
+    // Offsets within a block of memory handed out one after another and given back all at once.
+    class linear_range
+    {
+    public:
+        explicit linear_range(const vk::DeviceSize size) noexcept :
+                _size{size}
+        { }
+
+
+        [[nodiscard]] vk::DeviceSize size() const noexcept
+        {
+            return _size;
+        }
+
+        [[nodiscard]] vk::DeviceSize used() const noexcept
+        {
+            return _used;
+        }
+
+        [[nodiscard]] bool is_empty() const noexcept
+        {
+            return _used == 0;
+        }
+
+
+        [[nodiscard]] std::optional<vk::DeviceSize> allocate(
+                const vk::DeviceSize size, const vk::DeviceSize alignment) noexcept
+        {
+            const auto offset = align_up(_used, alignment);
+            if (offset + size > _size) return std::nullopt;
+
+            _used = offset + size;
+            return offset;
+        }
+
+        void reset() noexcept
+        {
+            _used = 0;
+        }
+
+
+    private:
+        vk::DeviceSize _size;
+        vk::DeviceSize _used{0};
+    };
+
+
+
+    // Free list pools hold memory released one allocation at a time, linear pools memory that is released in
+    // bulk, like everything that depends on the swapchain.
+    enum class memory_pool_kind : unsigned char
+    {
+        free_list,
+        linear
+    };
+
+    // What memory is used for, which decides the memory type it comes from:
+    //
+    // - device_static is only read by the device and filled by copies, so it stays out of host visible memory
+    //   where there is anything else,
+    // - host_dynamic is written by the host often and in order, so it is host visible and coherent but not
+    //   cached, which keeps writes combined,
+    // - host_readback is read by the host, so it is cached where possible.
+    enum class memory_class : unsigned char
+    {
+        device_static,
+        host_dynamic,
+        host_readback
+    };
+
+    struct memory_type_usage
+    {
+        unsigned int memory_type_index;
+
+        size_t block_count;
+        size_t allocation_count;
+
+        vk::DeviceSize reserved;
+        vk::DeviceSize used;
+    };
+
+
+    class device_memory_allocator;
+
+    // Part of a block of device memory, given back to its pool when destroyed unless the pool is linear.
+    // Host visible blocks are mapped as a whole for as long as they live, so allocations in them come mapped.
+    class memory_allocation
+    {
+    public:
+        memory_allocation() = default;
+
+        memory_allocation(const memory_allocation &) = delete;
+        memory_allocation &operator=(const memory_allocation &) = delete;
+
+        memory_allocation(memory_allocation &&other) noexcept
+        {
+            *this = std::move(other);
+        }
+
+        memory_allocation &operator=(memory_allocation &&other) noexcept;
+
+        ~memory_allocation();
+
+
+        [[nodiscard]] const vk::DeviceMemory &memory() const noexcept
+        {
+            return _memory;
+        }
+
+        [[nodiscard]] vk::DeviceSize offset() const noexcept
+        {
+            return _offset;
+        }
+
+        [[nodiscard]] vk::DeviceSize size() const noexcept
+        {
+            return _size;
+        }
+
+        // Null unless the memory is host visible.
+        [[nodiscard]] void *mapping() const noexcept
+        {
+            return _mapping;
+        }
+
+
+    private:
+        friend class device_memory_allocator;
+
+        device_memory_allocator *_allocator{nullptr};
+        void *_block{nullptr};
+
+        vk::DeviceMemory _memory{ };
+        vk::DeviceSize _offset{0};
+        vk::DeviceSize _size{0};
+        void *_mapping{nullptr};
+    };
+
+
+    // Sub-allocates device memory from large blocks, with a free list and a linear pool per memory type, so
+    // that buffers don't each cost an allocation out of the few maxMemoryAllocationCount allows. Requests
+    // larger than a block get a block of their own. Only buffers are placed in the blocks, so
+    // bufferImageGranularity doesn't apply.
+    //
+    // The allocator has to outlive its allocations.
+    class device_memory_allocator
+    {
+    public:
+        static constexpr vk::DeviceSize default_block_size = vk::DeviceSize{64} << 20;
+
+
+        [[nodiscard]] explicit device_memory_allocator(
+                const device &device,
+                const vk::DeviceSize block_size = default_block_size) :
+
+                _device{*device},
+                _memory_properties{device.physical().getMemoryProperties()},
+                _block_size{block_size},
+
+                _free_list_pools(_memory_properties.memoryTypeCount),
+                _linear_pools(_memory_properties.memoryTypeCount)
+        { }
+
+        device_memory_allocator(const device_memory_allocator &) = delete;
+        device_memory_allocator &operator=(const device_memory_allocator &) = delete;
+
+
+        [[nodiscard]] const vk::PhysicalDeviceMemoryProperties &memory_properties() const noexcept
+        {
+            return _memory_properties;
+        }
+
+
+        // Memory of the device static class is host visible and coherent only where the device has no memory
+        // that isn't, like on integrated GPUs and CPU implementations such as lavapipe. Static data can then be
+        // written in place instead of being staged.
+        [[nodiscard]] bool is_unified_memory() const
+        {
+            const auto &flags = _memory_properties.memoryTypes[
+                    find_memory_type_index(~0u, memory_class::device_static)].propertyFlags;
+
+            return (flags & vk::MemoryPropertyFlagBits::eHostVisible) &&
+                   (flags & vk::MemoryPropertyFlagBits::eHostCoherent);
+        }
+
+
+        [[nodiscard]] memory_allocation allocate(
+                const vk::MemoryRequirements &requirements,
+                const memory_class memory_class,
+                const memory_pool_kind kind = memory_pool_kind::free_list)
+        {
+            const auto memory_type_index = find_memory_type_index(requirements.memoryTypeBits, memory_class);
+
+            return kind == memory_pool_kind::free_list ?
+                   _allocate(_free_list_pools[memory_type_index], memory_type_index, requirements) :
+                   _allocate(_linear_pools[memory_type_index], memory_type_index, requirements);
+        }
+
+        // Allocates memory fitting the buffer and binds it.
+        [[nodiscard]] memory_allocation allocate_for(
+                const vk::Buffer &buffer,
+                const memory_class memory_class,
+                const memory_pool_kind kind = memory_pool_kind::free_list)
+        {
+            auto result = allocate(_device.getBufferMemoryRequirements(buffer), memory_class, kind);
+            _device.bindBufferMemory(buffer, result.memory(), result.offset());
+
+            return result;
+        }
+
+        // Makes device writes visible to the host, which readback memory that isn't host coherent needs after
+        // the device is done writing. Covers the whole block, which keeps the range within the atom size rules.
+        void invalidate(const memory_allocation &allocation) const
+        {
+            _device.invalidateMappedMemoryRanges({vk::MappedMemoryRange{allocation.memory(), 0, VK_WHOLE_SIZE}});
+        }
+
+        // Gives back everything allocated from linear pools, keeping the blocks for what comes next. Nothing
+        // may still use those allocations.
+        void reset_linear_pools() noexcept
+        {
+            for (auto &pool : _linear_pools)
+                for (auto &block : pool)
+                {
+                    block->range.reset();
+                    block->allocation_count = 0;
+                }
+        }
+
+
+        // Picks the type with all required properties of the class that has the most preferred and the fewest
+        // avoided ones, the first of those on ties.
+        [[nodiscard]] unsigned int find_memory_type_index(
+                const unsigned int memory_type_bits,
+                const memory_class memory_class) const
+        {
+            const auto [required, preferred, avoided] = _get_class_properties(memory_class);
+
+            std::optional<unsigned int> result{ };
+            int best_score = 0;
+
+            for (unsigned int i = 0 ; i < _memory_properties.memoryTypeCount ; ++i)
+            {
+                const auto &flags = _memory_properties.memoryTypes[i].propertyFlags;
+                if (!(memory_type_bits & 1u << i) || (flags & required) != required) continue;
+
+                const auto score = _count_properties(flags & preferred) - _count_properties(flags & avoided);
+                if (!result.has_value() || score > best_score)
+                {
+                    result = i;
+                    best_score = score;
+                }
+            }
+
+            if (!result.has_value())
+            {
+                throw std::runtime_error("Failed to find suitable memory type");
+            }
+
+            return result.value();
+        }
+
+        // One entry per memory type with any blocks.
+        [[nodiscard]] std::vector<memory_type_usage> get_usage() const
+        {
+            std::vector<memory_type_usage> result{ };
+
+            for (unsigned int i = 0 ; i < _memory_properties.memoryTypeCount ; ++i)
+            {
+                memory_type_usage usage{i, 0, 0, 0, 0};
+                _add_usage(_free_list_pools[i], usage);
+                _add_usage(_linear_pools[i], usage);
+
+                if (usage.block_count > 0) result.emplace_back(usage);
+            }
+
+            return result;
+        }
+
+
+    private:
+        friend class memory_allocation;
+
+        template<typename Range>
+        struct block
+        {
+            vk::UniqueDeviceMemory memory;
+            std::byte *mapping;
+
+            Range range;
+            size_t allocation_count;
+        };
+
+        template<typename Range>
+        using pool = std::vector<std::unique_ptr<block<Range>>>;
+
+
+        vk::Device _device;
+        vk::PhysicalDeviceMemoryProperties _memory_properties;
+        vk::DeviceSize _block_size;
+
+        std::vector<pool<free_list_range>> _free_list_pools;
+        std::vector<pool<linear_range>> _linear_pools;
+
+
+        struct class_properties
+        {
+            vk::MemoryPropertyFlags required;
+            vk::MemoryPropertyFlags preferred;
+            vk::MemoryPropertyFlags avoided;
+        };
+
+        [[nodiscard]] static class_properties _get_class_properties(const memory_class memory_class) noexcept
+        {
+            switch (memory_class)
+            {
+                case memory_class::device_static:
+                    return
+                            {
+                                    vk::MemoryPropertyFlagBits::eDeviceLocal,
+                                    { },
+                                    vk::MemoryPropertyFlagBits::eHostVisible
+                            };
+
+                case memory_class::host_dynamic:
+                    return
+                            {
+                                    vk::MemoryPropertyFlagBits::eHostVisible |
+                                    vk::MemoryPropertyFlagBits::eHostCoherent,
+                                    { },
+                                    vk::MemoryPropertyFlagBits::eHostCached
+                            };
+
+                case memory_class::host_readback:
+                default:
+                    return
+                            {
+                                    vk::MemoryPropertyFlagBits::eHostVisible,
+                                    vk::MemoryPropertyFlagBits::eHostCached |
+                                    vk::MemoryPropertyFlagBits::eHostCoherent,
+                                    { }
+                            };
+            }
+        }
+
+        [[nodiscard]] static int _count_properties(const vk::MemoryPropertyFlags &properties) noexcept
+        {
+            auto bits = static_cast<VkMemoryPropertyFlags>(properties);
+
+            int result = 0;
+            for ( ; bits != 0 ; bits &= bits - 1) ++result;
+
+            return result;
+        }
+
+
+        template<typename Range>
+        [[nodiscard]] memory_allocation _allocate(
+                pool<Range> &pool,
+                const unsigned int memory_type_index,
+                const vk::MemoryRequirements &requirements)
+        {
+            for (auto &current : pool)
+                if (const auto offset = current->range.allocate(requirements.size, requirements.alignment))
+                    return _make_allocation(*current, offset.value(), requirements.size);
+
+            auto &added = *pool.emplace_back(
+                    _create_block<Range>(memory_type_index, std::max(_block_size, requirements.size)));
+
+            return _make_allocation(added, added.range.allocate(requirements.size, requirements.alignment).value(),
+                                    requirements.size);
+        }
+
+        template<typename Range>
+        [[nodiscard]] memory_allocation _make_allocation(
+                block<Range> &owner,
+                const vk::DeviceSize offset,
+                const vk::DeviceSize size)
+        {
+            ++owner.allocation_count;
+
+            memory_allocation result{ };
+            result._memory = *owner.memory;
+            result._offset = offset;
+            result._size = size;
+            result._mapping = owner.mapping ? owner.mapping + offset : nullptr;
+
+            // Linear allocations go back in bulk, so they don't need to find their block.
+            if constexpr (std::is_same_v<Range, free_list_range>)
+            {
+                result._allocator = this;
+                result._block = &owner;
+            }
+
+            return result;
+        }
+
+        template<typename Range>
+        [[nodiscard]] std::unique_ptr<block<Range>> _create_block(
+                const unsigned int memory_type_index,
+                const vk::DeviceSize size) const
+        {
+            auto memory = _device.allocateMemoryUnique({size, memory_type_index});
+
+            std::byte *mapping = nullptr;
+            if (_memory_properties.memoryTypes[memory_type_index].propertyFlags &
+                vk::MemoryPropertyFlagBits::eHostVisible)
+            {
+                mapping = static_cast<std::byte *>(_device.mapMemory(*memory, 0, VK_WHOLE_SIZE, { }));
+            }
+
+#if !defined(NDEBUG)
+            std::cout << "Memory block of " << size << " bytes allocated" << std::endl;
+#endif
+
+            return std::unique_ptr<block<Range>>{new block<Range>{std::move(memory), mapping, Range{size}, 0}};
+        }
+
+        // Blocks left empty are freed, except for the last one of their pool, which stays for what comes next.
+        void _release(const memory_allocation &allocation)
+        {
+            auto &owner = *static_cast<block<free_list_range> *>(allocation._block);
+            owner.range.release(allocation._offset, allocation._size);
+            --owner.allocation_count;
+
+            if (owner.allocation_count > 0) return;
+
+            for (auto &pool : _free_list_pools)
+            {
+                const auto found = std::find_if(
+                        pool.begin(), pool.end(),
+                        [&owner](const auto &candidate)
+                        {
+                            return candidate.get() == &owner;
+                        });
+
+                if (found == pool.end()) continue;
+                if (pool.size() > 1) pool.erase(found);
+
+                return;
+            }
+        }
+
+        template<typename Range>
+        static void _add_usage(const pool<Range> &pool, memory_type_usage &usage) noexcept
+        {
+            for (const auto &current : pool)
+            {
+                ++usage.block_count;
+                usage.allocation_count += current->allocation_count;
+                usage.reserved += current->range.size();
+                usage.used += current->range.used();
+            }
+        }
+    };
+
+
+    inline memory_allocation &memory_allocation::operator=(memory_allocation &&other) noexcept
+    {
+        if (this == &other) return *this;
+
+        if (_allocator) _allocator->_release(*this);
+
+        _allocator = std::exchange(other._allocator, nullptr);
+        _block = std::exchange(other._block, nullptr);
+        _memory = std::exchange(other._memory, vk::DeviceMemory{ });
+        _offset = std::exchange(other._offset, 0);
+        _size = std::exchange(other._size, 0);
+        _mapping = std::exchange(other._mapping, nullptr);
+
+        return *this;
+    }
+
+    inline memory_allocation::~memory_allocation()
+    {
+        if (_allocator) _allocator->_release(*this);
+    }
+}
+
+#endif
@@ -11,6 +11,9 @@
 
 #include "render_pass.hpp"
 #include "shader_manager.hpp"
+#include "pipeline_cache.hpp"
+#include "retired_objects.hpp"
+#include "frame_timings.hpp"
 
 
 namespace il
@@ -33,13 +36,17 @@ namespace il
     #endif
         };
 
+        static inline const std::string pipeline_cache_path{ "./shaders/compiled/pipeline.ilcache" };
+
 	public:
 		explicit pipeline(
             const device& device,
             const swapchain& swapchain,
-            const MemoryManager& memory_manager) :
+            const MemoryManager& memory_manager,
+            const size_t frame_count) :
 
             render_pass_{ device, swapchain },
+            render_pass_format_{ swapchain.get_configuration().format },
 
             shader_manager_
 			{
@@ -55,16 +62,21 @@ namespace il
                 },
 				device
             },
+            pipeline_cache_{ device, pipeline_cache_path, shader_manager_.code_hash() },
 
 			descriptor_set_layout_{ create_descriptor_set_layout(device) },
             pipeline_layout_{ create_pipeline_layout(device) },
-			inner_{ create_inner(device, swapchain) },
+			inner_{ create_inner(device) },
+
+            descriptor_pool_{ create_descriptor_pool(device, memory_manager) },
+            descriptor_sets_{ create_descriptor_sets(device, memory_manager) },
 
 			image_views_{ create_image_views(device, swapchain) },
             framebuffers_{ create_frame_buffers(device, swapchain) },
 
-			draw_command_pool_{ create_draw_command_pool(device) },
-            draw_command_buffers_{ create_draw_command_buffers(device, swapchain, memory_manager) }
+            frame_recordings_{ create_frame_recordings(device, frame_count) },
+            render_pass_timestamps_{ device, frame_count },
+            image_recordings_(framebuffers_.size())
 		{
 #if !defined(NDEBUG)
             std::cout << std::endl << "-- Pipeline done --" << std::endl << std::endl;
@@ -76,22 +88,89 @@ namespace il
             return *inner_;
 		}
 
-		[[nodiscard]] const vk::CommandBuffer& command_buffer(const size_t index) const
+        // How long creating the graphics pipeline took the last time, at startup or on reconstruction, and
+        // whether the pipeline cache was loaded from disk for it.
+        [[nodiscard]] std::chrono::microseconds pipeline_creation_time() const
+		{
+            return pipeline_creation_time_;
+		}
+
+        [[nodiscard]] bool is_pipeline_cache_warm() const
+		{
+            return pipeline_cache_.is_warm();
+		}
+
+        // Records the commands of the frame, which draws to the image, and returns them. Neither the frame nor
+        // the image may be in flight. The primary command buffer of the frame is recorded every time from its
+        // reset pool and only executes the secondary ones of the image. Those are recorded again only when the
+        // drawn geometry or which of it is visible changed, in batches on separate threads if there is a lot of it.
+        [[nodiscard]] vk::CommandBuffer record_frame(
+            const device& device,
+            const size_t frame,
+            const size_t image_index,
+            const swapchain& swapchain,
+            const MemoryManager& memory_manager)
+		{
+            auto& image = image_recordings_[image_index];
+            if (image.generation != memory_manager.draw_generation())
+                record_draw_batches(
+                    device, image, image_index, swapchain.get_configuration().extent, memory_manager);
+
+            const auto& recording = frame_recordings_[frame];
+            device->resetCommandPool(*recording.pool, {});
+
+            record_primary_command_buffer(*recording.primary, frame, image, image_index, swapchain);
+
+            return *recording.primary;
+		}
+
+        // How long the device took for the render pass of the last frame recorded for the slot, once its fence
+        // was waited for. Nothing if it was read already or the device can't write timestamps.
+        [[nodiscard]] std::optional<std::chrono::nanoseconds> read_render_pass_time(
+            const device& device,
+            const size_t frame)
 		{
-            return *draw_command_buffers_[index];
+            return render_pass_timestamps_.read(device, frame);
 		}
 
 		
+        // Creates again what depends on the new swapchain images. Viewport and scissor are set while recording,
+        // so the render pass and the graphics pipeline only change with the image format and descriptor sets
+        // with the number of images, which the memory manager recreates uniform buffers for. The device has to
+        // be idle for those; image views and framebuffers are retired instead, since only they change with the
+        // extent.
         void reconstruct(
             const device& device,
             const swapchain& swapchain, 
-            const MemoryManager& memory_manager)
+            const MemoryManager& memory_manager,
+            retired_objects& retired)
 		{
-            render_pass_.reconstruct(device, swapchain);
-            inner_ = create_inner(device, swapchain);
+            if (swapchain.get_configuration().format != render_pass_format_)
+            {
+                render_pass_.reconstruct(device, swapchain);
+                render_pass_format_ = swapchain.get_configuration().format;
+                inner_ = create_inner(device);
+            }
+
+            if (descriptor_sets_.size() != memory_manager.uniform_buffer_count())
+            {
+                // Sets go first, they can't outlive their pool.
+                descriptor_sets_.clear();
+                descriptor_pool_ = create_descriptor_pool(device, memory_manager);
+                descriptor_sets_ = create_descriptor_sets(device, memory_manager);
+            }
+
+            retired.retire(std::move(image_views_));
+            retired.retire(std::move(framebuffers_));
+
             image_views_ = create_image_views(device, swapchain);
             framebuffers_ = create_frame_buffers(device, swapchain);
-            draw_command_buffers_ = create_draw_command_buffers(device, swapchain, memory_manager);
+
+            // Secondary command buffers inherit the framebuffers and set the viewport, so all of them are
+            // recorded again. Their pools are kept for it, and each is only reset once the last frame drawing
+            // to its image is done.
+            image_recordings_.resize(framebuffers_.size());
+            for (auto& image : image_recordings_) image.generation.reset();
 #if !defined(NDEBUG)
             std::cout << std::endl << "-- Pipeline reconstructed --" << std::endl << std::endl;
 #endif
@@ -100,18 +179,57 @@ namespace il
 		
 	private:
         render_pass render_pass_;
+        vk::Format render_pass_format_;
 
         const shader_manager shader_manager_;
+        pipeline_cache pipeline_cache_;
+        std::chrono::microseconds pipeline_creation_time_{};
 
         vk::UniqueDescriptorSetLayout descriptor_set_layout_;
         vk::UniquePipelineLayout pipeline_layout_;
         vk::UniquePipeline inner_;
 
+        vk::UniqueDescriptorPool descriptor_pool_;
+        std::vector<vk::UniqueDescriptorSet> descriptor_sets_;
+
         std::vector<vk::UniqueImageView> image_views_;
         std::vector<vk::UniqueFramebuffer> framebuffers_;
 
-        const vk::UniqueCommandPool draw_command_pool_;
-        std::vector<vk::UniqueCommandBuffer> draw_command_buffers_;
+        struct frame_recording
+        {
+            vk::UniqueCommandPool pool;
+            vk::UniqueCommandBuffer primary;
+        };
+
+        struct image_recording
+        {
+            // One pool per batch, so that batches can be recorded on separate threads.
+            std::vector<vk::UniqueCommandPool> pools{};
+            std::vector<vk::UniqueCommandBuffer> secondaries{};
+            size_t batch_count{ 0 };
+
+            // Draw generation the batches were recorded for, none before they are recorded first.
+            std::optional<size_t> generation{};
+        };
+
+        // Consecutive triangles of a part, counted from its first index or, if it has none, its first vertex.
+        struct draw_piece
+        {
+            size_t draw;
+
+            size_t first;
+            size_t count;
+        };
+
+        // Pieces recorded into one secondary command buffer, in order.
+        using draw_batch = std::vector<draw_piece>;
+
+        // Draws are only split once every thread gets at least as many triangles.
+        static constexpr size_t min_batch_triangle_count = 1 << 14;
+
+        const std::vector<frame_recording> frame_recordings_;
+        render_pass_timestamps render_pass_timestamps_;
+        std::vector<image_recording> image_recordings_;
 
 
 		[[nodiscard]] static vk::UniqueDescriptorSetLayout create_descriptor_set_layout(
@@ -122,7 +240,7 @@ namespace il
                 0,
                 vk::DescriptorType::eUniformBuffer,
                 1,
-                {},
+                vk::ShaderStageFlagBits::eVertex,
                 nullptr,
             };
             const vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_create_info
@@ -132,14 +250,92 @@ namespace il
                 &descriptor_set_layout_binding
             };
 
-            const auto result = 
+            auto result = 
                 device->createDescriptorSetLayoutUnique(descriptor_set_layout_create_info);
 			
 #if !defined(NDEBUG)
             std::cout << "Descriptor set layout created" << std::endl;
 #endif
 
-            return device->createDescriptorSetLayoutUnique(descriptor_set_layout_create_info);
+            return result;
+		}
+
+        [[nodiscard]] static vk::UniqueDescriptorPool create_descriptor_pool(
+            const device& device,
+            const MemoryManager& memory_manager)
+		{
+            const auto set_count = static_cast<unsigned int>(memory_manager.uniform_buffer_count());
+
+            const vk::DescriptorPoolSize pool_size
+            {
+                vk::DescriptorType::eUniformBuffer,
+                set_count
+            };
+
+            auto result = device->createDescriptorPoolUnique(
+                {
+                    vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                    set_count,
+                    1,
+                    &pool_size
+                });
+
+#if !defined(NDEBUG)
+            std::cout << "Descriptor pool created" << std::endl;
+#endif
+
+            return result;
+		}
+
+        // One set per swapchain image, each pointing to the uniform buffer of that image.
+        [[nodiscard]] std::vector<vk::UniqueDescriptorSet> create_descriptor_sets(
+            const device& device,
+            const MemoryManager& memory_manager) const
+		{
+            const std::vector<vk::DescriptorSetLayout> layouts
+            {
+                memory_manager.uniform_buffer_count(),
+                *descriptor_set_layout_
+            };
+
+            auto result = device->allocateDescriptorSetsUnique(
+                {
+                    *descriptor_pool_,
+                    static_cast<unsigned int>(layouts.size()),
+                    layouts.data()
+                });
+
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                const vk::DescriptorBufferInfo buffer_info
+                {
+                    memory_manager.uniform_buffer(i),
+                    0,
+                    sizeof(frame_uniforms)
+                };
+
+                device->updateDescriptorSets(
+                    {
+                        vk::WriteDescriptorSet
+                        {
+                            *result[i],
+                            0,
+                            0,
+                            1,
+                            vk::DescriptorType::eUniformBuffer,
+                            nullptr,
+                            &buffer_info,
+                            nullptr
+                        }
+                    },
+                    {});
+            }
+
+#if !defined(NDEBUG)
+            std::cout << "Descriptor sets created" << std::endl;
+#endif
+
+            return result;
 		}
 		
         [[nodiscard]] vk::UniquePipelineLayout create_pipeline_layout(const device& device) const
@@ -166,9 +362,7 @@ namespace il
             return result;
         }
 
-        [[nodiscard]] vk::UniquePipeline create_inner(
-            const device& device,
-            const swapchain& swapchain) const
+        [[nodiscard]] vk::UniquePipeline create_inner(const device& device)
         {
             const auto vertex_input_binding_descriptions =
                 GraphicsVertex::get_binding_descriptions();
@@ -193,35 +387,27 @@ namespace il
                 VK_FALSE
             };
 
-            std::vector<vk::Viewport> viewports
+            // Set while recording, so that the pipeline outlives the extent.
+            vk::PipelineViewportStateCreateInfo viewport_state_create_info
             {
-                vk::Viewport
-                {
-                    0.0f,
-                    0.0f,
-                    static_cast<float>(swapchain.get_configuration().extent.width),
-                    static_cast<float>(swapchain.get_configuration().extent.height),
-                    0.0f,
-                    1.0f
-                }
+                {},
+                1,
+                nullptr,
+                1,
+                nullptr
             };
 
-            std::vector<vk::Rect2D> scissors
+            std::vector<vk::DynamicState> dynamic_states
             {
-                vk::Rect2D
-                {
-                    { 0, 0 },
-                    swapchain.get_configuration().extent
-                }
+                vk::DynamicState::eViewport,
+                vk::DynamicState::eScissor
             };
 
-            vk::PipelineViewportStateCreateInfo viewport_state_create_info
+            vk::PipelineDynamicStateCreateInfo dynamic_state_create_info
             {
                 {},
-                static_cast<unsigned int>(viewports.size()),
-                viewports.data(),
-                static_cast<unsigned int>(scissors.size()),
-                scissors.data()
+                static_cast<unsigned int>(dynamic_states.size()),
+                dynamic_states.data()
             };
 
             vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info
@@ -287,8 +473,10 @@ namespace il
             const auto& shader_stages_create_info = 
                 shader_manager_.shader_stages_create_info();
         	
+            const auto start = std::chrono::steady_clock::now();
+
             auto result = device->createGraphicsPipelineUnique(
-                nullptr,
+                *pipeline_cache_,
                 vk::GraphicsPipelineCreateInfo
                 {
                     {},
@@ -305,7 +493,7 @@ namespace il
                     nullptr,
                     &color_blend_state_create_info,
 
-                    nullptr,
+                    &dynamic_state_create_info,
                 	
                 	*pipeline_layout_,
                     *render_pass_,
@@ -314,13 +502,38 @@ namespace il
                     {}
                 });
 
+            pipeline_creation_time_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+
 #if !defined(NDEBUG)
-            std::cout << "Graphics pipeline created" << std::endl;
+            std::cout << "Graphics pipeline created in " << pipeline_creation_time_.count() << "us with " <<
+                (pipeline_cache_.is_warm() ? "warm" : "cold") << " pipeline cache" << std::endl;
 #endif
 
+            save_pipeline_cache(device);
+
             return result;
         }
 
+        // Pipelines work without it, the next run just has to compile them again.
+        void save_pipeline_cache(const device& device)
+        {
+            try
+            {
+                pipeline_cache_.save(device);
+            }
+#if !defined(NDEBUG)
+            catch (const std::exception& error)
+            {
+                std::cerr << error.what() << std::endl;
+            }
+#else
+            catch (const std::exception&)
+            {
+            }
+#endif
+        }
+
         [[nodiscard]] static std::vector<vk::UniqueImageView> create_image_views(
             const device& device,
 			const swapchain& swapchain)
@@ -387,102 +600,277 @@ namespace il
             return framebuffers;
         }
 
-        [[nodiscard]] static vk::UniqueCommandPool create_draw_command_pool(const device& device)
+        [[nodiscard]] static std::vector<frame_recording> create_frame_recordings(
+            const device& device,
+            const size_t frame_count)
         {
-            auto result = device->createCommandPoolUnique(
-                {
-                    {},
-                    device.queue_family_indices.graphics_family.value()
-                });
+            std::vector<frame_recording> result{};
+            for (size_t i = 0; i < frame_count; ++i)
+            {
+                auto pool = device->createCommandPoolUnique(
+                    {
+                        vk::CommandPoolCreateFlagBits::eTransient,
+                        device.queue_family_indices.graphics_family.value()
+                    });
+
+                auto primary = std::move(device->allocateCommandBuffersUnique(
+                    {
+                        *pool,
+                        vk::CommandBufferLevel::ePrimary,
+                        1
+                    }).front());
+
+                result.emplace_back(frame_recording{ std::move(pool), std::move(primary) });
+            }
 
 #if !defined(NDEBUG)
-            std::cout << "Command pool created" << std::endl;
+            std::cout << "Frame command pools created" << std::endl;
 #endif
 
             return result;
         }
 
-        [[nodiscard]] std::vector<vk::UniqueCommandBuffer> create_draw_command_buffers(
-			const device& device,
-            const swapchain& swapchain,
-            const MemoryManager& memory_manager) const
+        void record_primary_command_buffer(
+            const vk::CommandBuffer& command_buffer,
+            const size_t frame,
+            const image_recording& image,
+            const size_t image_index,
+            const swapchain& swapchain)
         {
-            auto command_buffers
+            command_buffer.begin(
+                {
+                    vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                    nullptr
+                });
+
+            std::vector<vk::ClearValue> clear_values
             {
-                device->allocateCommandBuffersUnique(
-                    vk::CommandBufferAllocateInfo
+                vk::ClearValue
+                {
+                    vk::ClearColorValue
                     {
-                        *draw_command_pool_,
-                        vk::CommandBufferLevel::ePrimary,
-                        static_cast<unsigned int>(framebuffers_.size())
-                    })
+                        std::array<float, 4>
+                        {
+                            0.0f,
+                            0.0f,
+                            0.0f,
+                            1.0f
+                        }
+                    }
+                }
             };
 
-            for (size_t i = 0; i < command_buffers.size(); ++i)
+            render_pass_timestamps_.write_begin(command_buffer, frame);
+
+            command_buffer.beginRenderPass(
+                {
+                    *render_pass_,
+                    *framebuffers_[image_index],
+                    vk::Rect2D
+                    {
+                        { 0, 0 },
+                        swapchain.get_configuration().extent
+                    },
+                    static_cast<unsigned int>(clear_values.size()),
+                    clear_values.data()
+                },
+                vk::SubpassContents::eSecondaryCommandBuffers);
+
+            std::vector<vk::CommandBuffer> secondaries{};
+            for (size_t i = 0; i < image.batch_count; ++i) secondaries.emplace_back(*image.secondaries[i]);
+
+            if (!secondaries.empty()) command_buffer.executeCommands(secondaries);
+
+            command_buffer.endRenderPass();
+
+            render_pass_timestamps_.write_end(command_buffer, frame);
+
+            command_buffer.end();
+        }
+
+        [[nodiscard]] static size_t get_draw_count(const geometry_draw& draw)
+        {
+            return draw.index_count > 0 ? draw.index_count : draw.vertex_count;
+        }
+
+        // Splits the indices or vertices of all draws into batches of whole triangles of about the same size, at
+        // most one per thread. Draws are cut where a batch is full.
+        [[nodiscard]] static std::vector<draw_batch> split_draws(
+            const std::vector<geometry_draw>& draws,
+            const size_t thread_count)
+        {
+            size_t triangle_count = 0;
+            for (const auto& draw : draws) triangle_count += (get_draw_count(draw) + 2) / 3;
+
+            const auto batch_count = std::clamp(
+                triangle_count / min_batch_triangle_count,
+                static_cast<size_t>(1),
+                std::max(thread_count, static_cast<size_t>(1)));
+            const auto batch_size = (triangle_count + batch_count - 1) / batch_count * 3;
+
+            std::vector<draw_batch> result{};
+            size_t batch_remainder = 0;
+
+            for (size_t i = 0; i < draws.size(); ++i)
             {
-                command_buffers[i]->begin(
+                const auto count = get_draw_count(draws[i]);
+                for (size_t first = 0; first < count;)
+                {
+                    if (batch_remainder == 0)
+                    {
+                        result.emplace_back();
+                        batch_remainder = batch_size;
+                    }
+
+                    const auto piece_count = std::min(batch_remainder, count - first);
+                    result.back().emplace_back(draw_piece{ i, first, piece_count });
+
+                    first += piece_count;
+                    batch_remainder -= piece_count;
+                }
+            }
+
+            return result;
+        }
+
+        void record_draw_batches(
+            const device& device,
+            image_recording& image,
+            const size_t image_index,
+            const vk::Extent2D& extent,
+            const MemoryManager& memory_manager) const
+        {
+            const auto draws = memory_manager.get_geometry_draws();
+            const auto batches = split_draws(draws, thread_pool::get_shared().thread_count());
+
+            while (image.pools.size() < batches.size())
+            {
+                image.pools.emplace_back(device->createCommandPoolUnique(
                     {
                         {},
-                        nullptr
-                    });
+                        device.queue_family_indices.graphics_family.value()
+                    }));
+
+                image.secondaries.emplace_back(std::move(device->allocateCommandBuffersUnique(
+                    {
+                        *image.pools.back(),
+                        vk::CommandBufferLevel::eSecondary,
+                        1
+                    }).front()));
+            }
+
+            // Each batch has its own pool, which is all Vulkan asks of recording on separate threads.
+            run_parallel(batches.size(), [&](const size_t i)
+                {
+                    device->resetCommandPool(*image.pools[i], {});
+                    record_draw_batch(*image.secondaries[i], image_index, extent, draws, batches[i]);
+                });
+
+            image.batch_count = batches.size();
+            image.generation = memory_manager.draw_generation();
+        }
+
+        void record_draw_batch(
+            const vk::CommandBuffer& command_buffer,
+            const size_t image_index,
+            const vk::Extent2D& extent,
+            const std::vector<geometry_draw>& draws,
+            const draw_batch& batch) const
+        {
+            const vk::CommandBufferInheritanceInfo inheritance
+            {
+                *render_pass_,
+                0,
+                *framebuffers_[image_index]
+            };
+
+            command_buffer.begin(
+                {
+                    vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+                    &inheritance
+                });
 
-                std::vector<vk::ClearValue> clear_values
+            command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *inner_);
+
+            command_buffer.setViewport(0,
                 {
-                    vk::ClearValue
+                    vk::Viewport
                     {
-                        vk::ClearColorValue
-                        {
-                            std::array<float, 4>
-                            {
-                                0.0f,
-                                0.0f,
-                                0.0f,
-                                1.0f
-                            }
-                        }
+                        0.0f,
+                        0.0f,
+                        static_cast<float>(extent.width),
+                        static_cast<float>(extent.height),
+                        0.0f,
+                        1.0f
                     }
-                };
+                });
 
-                command_buffers[i]->beginRenderPass(
+            command_buffer.setScissor(0,
+                {
+                    vk::Rect2D
                     {
-                        *render_pass_,
-                        *framebuffers_[i],
-                        vk::Rect2D
+                        { 0, 0 },
+                        extent
+                    }
+                });
+
+            command_buffer.bindDescriptorSets(
+                vk::PipelineBindPoint::eGraphics,
+                *pipeline_layout_,
+                0,
+                {
+                    *descriptor_sets_[image_index]
+                },
+                {});
+
+            // Parts in the same chunk share their buffers, which are only bound again for the next chunk.
+            vk::Buffer bound_buffer{};
+            std::optional<vk::DeviceSize> bound_index_offset{};
+
+            for (const auto& piece : batch)
+            {
+                const auto& draw = draws[piece.draw];
+
+                if (draw.buffer != bound_buffer)
+                {
+                    command_buffer.bindVertexBuffers(0,
                         {
-                            { 0, 0 },
-                            swapchain.get_configuration().extent
+                            draw.buffer
                         },
-                        static_cast<unsigned int>(clear_values.size()),
-                        clear_values.data()
-                    },
-                    vk::SubpassContents::eInline);
+                        {
+                            0
+                        });
 
-                command_buffers[i]->bindPipeline(vk::PipelineBindPoint::eGraphics, *inner_);
+                    bound_buffer = draw.buffer;
+                    bound_index_offset.reset();
+                }
 
-                command_buffers[i]->bindVertexBuffers(0,
-                    {
-                        memory_manager.vertex_buffer()
-                    },
+                if (draw.index_count > 0)
+                {
+                    if (bound_index_offset != draw.index_offset)
                     {
-                        0
-                    });
-            	
-                command_buffers[i]->draw(
-                        MemoryManager::vertex_count,
+                        command_buffer.bindIndexBuffer(draw.buffer, draw.index_offset, graphics_index_type);
+                        bound_index_offset = draw.index_offset;
+                    }
+
+                    command_buffer.drawIndexed(
+                        static_cast<unsigned int>(piece.count),
                         1,
-                        0,
+                        static_cast<unsigned int>(draw.first_index + piece.first),
+                        static_cast<int>(draw.first_vertex),
                         0);
+                }
+                else
+                {
+                    command_buffer.draw(
+                        static_cast<unsigned int>(piece.count),
+                        1,
+                        static_cast<unsigned int>(draw.first_vertex + piece.first),
+                        0);
+                }
+            }
 
-                command_buffers[i]->endRenderPass();
-
-                command_buffers[i]->end();
-        	}
-
-#if !defined(NDEBUG)
-            std::cout << "Command buffers created" << std::endl;
-#endif
-
-            return command_buffers;
+            command_buffer.end();
         }
 
 	};
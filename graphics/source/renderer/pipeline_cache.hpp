@@ -0,0 +1,206 @@
+#ifndef IRGLAB_PIPELINE_CACHE_HPP
+#define IRGLAB_PIPELINE_CACHE_HPP
+
+
+#include "external/external.hpp"
+
+#include "environment/device.hpp"
+
+
+namespace il
+{
+    // Header of an '.ilcache' file, followed by data_size bytes of Vulkan pipeline cache data. The cache is only
+    // loaded by the same device, driver and shaders that wrote it, and only if its data is intact, since some
+    // drivers don't survive corrupt cache data. Stored in native byte order like mesh caches.
+    struct [[maybe_unused]] pipeline_cache_header
+    {
+        [[maybe_unused]] static constexpr std::array<char, 8> expected_magic{'I', 'L', 'P', 'C', 'A', 'C', 'H', 0};
+        [[maybe_unused]] static constexpr std::uint32_t current_version = 1;
+
+
+        std::array<char, 8> magic;
+        std::uint32_t version;
+
+        // Identify the device and driver, which only reuse their own pipeline caches.
+        std::uint32_t vendor_id;
+        std::uint32_t device_id;
+        std::uint32_t driver_version;
+        std::array<std::uint8_t, VK_UUID_SIZE> pipeline_cache_uuid;
+
+        // Identifies the shaders the pipelines were built from.
+        std::uint64_t shader_hash;
+
+        std::uint64_t data_size;
+        std::uint64_t data_hash;
+    };
+
+    static_assert(sizeof(pipeline_cache_header) == 64);
+    static_assert(std::is_trivially_copyable_v<pipeline_cache_header>);
+
+
+    // Vulkan pipeline cache kept on disk between runs, so that pipelines are only compiled on the first run with
+    // new shaders or a new driver. Anything on disk that doesn't match is ignored and later overwritten.
+    class [[maybe_unused]] pipeline_cache
+    {
+    public:
+        // Constructors and related methods
+
+        [[nodiscard, maybe_unused]] pipeline_cache(
+                const device& device,
+                std::string path,
+                const std::uint64_t shader_hash) :
+                path{std::move(path)},
+                _key{_create_key(device, shader_hash)},
+                _inner{_create_inner(device)}
+        { }
+
+
+        const std::string path;
+
+
+        // Accessors
+
+        [[nodiscard, maybe_unused]] const vk::PipelineCache& operator*() const noexcept
+        {
+            return *_inner;
+        }
+
+        // Whether the cache on disk was valid and loaded.
+        [[nodiscard, maybe_unused]] bool is_warm() const noexcept
+        {
+            return _is_warm;
+        }
+
+
+        // Modifiers
+
+        // Writes the cache unless it is the same as on disk already, which is the case after creating pipelines
+        // that were cached before.
+        [[maybe_unused]] void save(const device& device)
+        {
+            const auto data = device->getPipelineCacheData(*_inner);
+            const auto data_hash = hash_bytes(data.data(), data.size());
+
+            if (_written_data.has_value() &&
+                _written_data->first == data.size() &&
+                _written_data->second == data_hash)
+                return;
+
+#if !defined(NDEBUG)
+            std::cout << "Writing pipeline cache at: '" << path << "'." << std::endl;
+#endif
+
+            auto header = _key;
+            header.data_size = data.size();
+            header.data_hash = data_hash;
+
+            // Written next to the destination and renamed, so a reader never loads a half written file.
+            const auto temporary_path = path + ".tmp";
+            {
+                std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+                if (!file.is_open())
+                {
+                    throw std::runtime_error("Failed to open file from path '" + temporary_path + "'.");
+                }
+
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+                if (!file)
+                {
+                    throw std::runtime_error("Failed to write file at '" + temporary_path + "'.");
+                }
+            }
+
+            std::filesystem::rename(temporary_path, path);
+
+            _written_data = std::make_pair(data.size(), data_hash);
+        }
+
+
+        // Implementation details
+
+    private:
+        [[nodiscard]] static pipeline_cache_header _create_key(const device& device, const std::uint64_t shader_hash)
+        {
+            const auto properties = device.physical().getProperties();
+
+            pipeline_cache_header result{ };
+            result.magic = pipeline_cache_header::expected_magic;
+            result.version = pipeline_cache_header::current_version;
+            result.vendor_id = properties.vendorID;
+            result.device_id = properties.deviceID;
+            result.driver_version = properties.driverVersion;
+            std::memcpy(result.pipeline_cache_uuid.data(), &properties.pipelineCacheUUID[0], VK_UUID_SIZE);
+            result.shader_hash = shader_hash;
+
+            return result;
+        }
+
+        [[nodiscard]] vk::UniquePipelineCache _create_inner(const device& device)
+        {
+            const auto data = _read_data();
+
+            _is_warm = !data.empty();
+            if (_is_warm) _written_data = std::make_pair(data.size(), hash_bytes(data.data(), data.size()));
+
+            auto result = device->createPipelineCacheUnique(
+                    {
+                            { },
+                            data.size(),
+                            data.data()
+                    });
+
+#if !defined(NDEBUG)
+            std::cout << "Pipeline cache created " << (_is_warm ? "from '" + path + "'" : "empty") << std::endl;
+#endif
+
+            return result;
+        }
+
+        // Returns nothing if there is no valid cache for the key on disk.
+        [[nodiscard]] std::vector<char> _read_data() const
+        {
+            std::error_code error{ };
+            const auto file_size = std::filesystem::file_size(path, error);
+            if (error || file_size < sizeof(pipeline_cache_header)) return { };
+
+            std::ifstream file{path, std::ios::binary};
+            if (!file.is_open()) return { };
+
+            pipeline_cache_header header{ };
+            file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+            if (!file ||
+                header.magic != _key.magic ||
+                header.version != _key.version ||
+                header.vendor_id != _key.vendor_id ||
+                header.device_id != _key.device_id ||
+                header.driver_version != _key.driver_version ||
+                header.pipeline_cache_uuid != _key.pipeline_cache_uuid ||
+                header.shader_hash != _key.shader_hash ||
+                header.data_size != file_size - sizeof(pipeline_cache_header))
+                return { };
+
+            std::vector<char> result(static_cast<size_t>(header.data_size));
+            file.read(result.data(), static_cast<std::streamsize>(result.size()));
+
+            if (!file || hash_bytes(result.data(), result.size()) != header.data_hash) return { };
+
+            return result;
+        }
+
+
+        // Data
+
+        const pipeline_cache_header _key;
+
+        bool _is_warm{false};
+        // Size and hash of the data on disk, if it is valid.
+        std::optional<std::pair<size_t, std::uint64_t>> _written_data{ };
+
+        // Declared last, since creating it reads the cache into the members above.
+        vk::UniquePipelineCache _inner;
+    };
+}
+
+#endif
@@ -12,19 +12,23 @@
 #include "MemoryManager.hpp"
 #include "pipeline.hpp"
 #include "synchronizer.hpp"
+#include "frame_timings.hpp"
 
 
 namespace il
 {
 	struct artist
 	{
+		using adapt_callback [[maybe_unused]] = std::function<void(vk::Extent2D)>;
+
+
 		artist(const environment& environment, const std::shared_ptr<window>& window) :
 			window_{ window },
 			device_{ std::make_shared<il::device>(environment, *window) },
 
 			swapchain_{ device(), *window },
-			memory_manager_{ device_, swapchain_ },
-			pipeline_{ device(), swapchain_, memory_manager_ },
+			memory_manager_{ device_, swapchain_, max_frames_in_flight },
+			pipeline_{ device(), swapchain_, memory_manager_, max_frames_in_flight },
 
 			sync_
 			{
@@ -47,10 +51,7 @@ namespace il
 				}
 			}
 		{
-			window->on_resize([&](vk::Extent2D)
-				{
-					window_resized_ = true;
-				});
+			register_new_window(*window);
 
 			image_in_flight_fence_indices_.resize(swapchain_.get_configuration_view().image_count);
 
@@ -70,19 +71,34 @@ namespace il
 		// ReSharper disable CppExpressionWithoutSideEffects
 		void draw_frame()
 		{
-			device()->waitForFences(
-				sync_.fence(in_flight, current_frame_),
-				VK_TRUE,
-				UINT64_MAX); // Means there is no timeout
+			{
+				frame_timings::span span{ timings_, frame_stage::fence_wait };
+
+				device()->waitForFences(
+					sync_.fence(in_flight, current_frame_),
+					VK_TRUE,
+					UINT64_MAX); // Means there is no timeout
+			}
+
+			if (const auto render_pass_time = pipeline_.read_render_pass_time(device(), current_frame_)
+				; render_pass_time.has_value())
+				timings_.add(frame_stage::gpu_render_pass, render_pass_time.value());
+
+			retired_.release_done(max_frames_in_flight);
 
 			unsigned int image_index;
 			try
 			{
-				image_index = device()->acquireNextImageKHR(
+				frame_timings::span span{ timings_, frame_stage::acquire };
+
+				const auto acquired = device()->acquireNextImageKHR(
 					*swapchain_,
 					UINT64_MAX,
 					sync_.semaphore(image_available, current_frame_),
-					nullptr).value;
+					nullptr);
+
+				image_index = acquired.value;
+				if (acquired.result == vk::Result::eSuboptimalKHR) note_suboptimal_swapchain();
 			}
 #if !defined(NDEBUG)
 			catch (const vk::OutOfDateKHRError& out_of_date)
@@ -111,28 +127,54 @@ namespace il
 
 			image_in_flight_fence_indices_[image_index] = current_frame_;
 
+			// Nothing reads the uniforms of this image anymore.
+			memory_manager_.set_uniforms(image_index, uniforms_);
+
 			device()->resetFences(sync_.fence(in_flight, current_frame_));
 
 
-			device().graphics_queue.submit(
-				{
+			// Geometry written since the last frame is copied in on the transfer queue, and vertex input of the
+			// draw waits for the copy. The draw is recorded again only then.
+			std::array<vk::Semaphore, 2> wait_semaphores{ sync_.semaphore(image_available, current_frame_) };
+			unsigned int wait_semaphore_count = 1;
+			vk::CommandBuffer command_buffer;
+			{
+				frame_timings::span span{ timings_, frame_stage::record };
+
+				if (const auto upload = memory_manager_.take_geometry_upload(current_frame_); upload.has_value())
+					wait_semaphores[wait_semaphore_count++] = upload.value();
+
+				command_buffer =
+					pipeline_.record_frame(device(), current_frame_, image_index, swapchain_, memory_manager_);
+			}
+
+			{
+				frame_timings::span span{ timings_, frame_stage::submit };
+
+				device().graphics_queue.submit(
 					{
-						1,
-						&sync_.semaphore(image_available, current_frame_),
-						wait_stages.data(),
-						1,
-						&pipeline_.command_buffer(image_index),
-						1,
-						&sync_.semaphore(render_finished, current_frame_)
-					}
-				},
-				sync_.fence(in_flight, current_frame_));
+						{
+							wait_semaphore_count,
+							wait_semaphores.data(),
+							wait_stages.data(),
+							1,
+							&command_buffer,
+							1,
+							&sync_.semaphore(render_finished, current_frame_)
+						}
+					},
+					sync_.fence(in_flight, current_frame_));
+			}
+
+			retired_.count_submitted_frame();
 
 
-			vk::Result present_result;
+			bool is_swapchain_outdated = false;
 			try
 			{
-				present_result = device().present_queue.presentKHR(
+				frame_timings::span span{ timings_, frame_stage::present };
+
+				const auto present_result = device().present_queue.presentKHR(
 					{
 						1,
 						&sync_.semaphore(render_finished, current_frame_),
@@ -141,39 +183,28 @@ namespace il
 						&image_index,
 						nullptr
 					});
+
+				if (present_result == vk::Result::eSuboptimalKHR) note_suboptimal_swapchain();
 			}
 			catch (vk::OutOfDateKHRError&)
 			{
 #if !defined(NDEBUG)
 				std::cerr << "Swapchain is outdated." << std::endl;
 #endif
-
-				adapt();
-				return;
+				is_swapchain_outdated = true;
 			}
-			if (present_result == vk::Result::eSuboptimalKHR)
-			{
-#if !defined(NDEBUG)
-				std::cerr << "Swapchain is suboptimal." << std::endl;
-#endif
 
-				adapt();
-				return;
-			}
+			// The frame is in flight either way, so the next one goes to the next frame slot instead of waiting
+			// for this one.
+			current_frame_ = (current_frame_ + 1) % max_frames_in_flight;
 
-			if (window_resized_)
+			if (is_swapchain_outdated || is_resize_settled())
 			{
 #if !defined(NDEBUG)
-				std::cerr << "window resized." << std::endl;
+				if (!is_swapchain_outdated) std::cerr << "window resized." << std::endl;
 #endif
-				window_resized_ = false;
-
 				adapt();
-				return;
 			}
-
-
-			current_frame_ = (current_frame_ + 1) % max_frames_in_flight;
 		}
 		// ReSharper enable CppExpressionWithoutSideEffects
 
@@ -185,20 +216,139 @@ namespace il
 
 		using wire = std::pair<GraphicsVertex, GraphicsVertex>;
 
-		void set_wires_to_draw(const std::vector<wire>& wires) const
+		void set_wires_to_draw(const std::vector<wire>& wires)
+		{
+			const auto parts = write_vertices_in_parts(wires.size() * 2);
+
+			// Parts hold an even number of vertices, so no wire is split.
+			for (size_t i = 0; i < 2 * wires.size(); i += 2)
+			{
+				const auto& part = parts[i / MemoryManager::max_part_vertex_count];
+				const auto first = i % MemoryManager::max_part_vertex_count;
+
+				part[first] = wires[i / 2].first;
+				part[first + 1] = wires[i / 2].second;
+			}
+		}
+
+		void set_vertices_to_draw(const std::vector<GraphicsVertex>& vertices)
+		{
+			auto source = vertices.begin();
+			for (const auto& part : write_vertices_in_parts(vertices.size()))
+			{
+				std::copy(source, source + static_cast<std::ptrdiff_t>(part.size()), part.begin());
+				source += static_cast<std::ptrdiff_t>(part.size());
+			}
+		}
+
+		// Hands out the vertices of each part and indices into them to fill in place, which replace the drawn
+		// ones from the next frame on. Parts are drawn separately and have to be within the part limits of the
+		// memory manager. Only waits if the device is still on the frame as many frames back as there are in
+		// flight, which may be the last one to read the upload buffer handed out.
+		[[nodiscard]] std::vector<geometry_span> write_geometry(const std::vector<geometry_counts>& parts)
 		{
-			std::vector<GraphicsVertex> vertices{wires.size() * 2 };
+			device()->waitForFences(
+				sync_.fence(in_flight, current_frame_),
+				VK_TRUE,
+				UINT64_MAX);
+
+			return memory_manager_.write_geometry(parts);
+		}
+
+		// Like write_geometry, but parts with a kept part keep what was last written for that one instead of
+		// being handed out where they can, see MemoryManager::write_geometry.
+		[[nodiscard]] std::vector<std::optional<geometry_span>> write_geometry(
+			const std::vector<geometry_counts>& parts,
+			const std::vector<std::optional<size_t>>& kept_parts)
+		{
+			device()->waitForFences(
+				sync_.fence(in_flight, current_frame_),
+				VK_TRUE,
+				UINT64_MAX);
+
+			return memory_manager_.write_geometry(parts, kept_parts);
+		}
+
+		// Like write_geometry, for a single part.
+		[[nodiscard]] geometry_span write_geometry(const size_t vertex_count, const size_t index_count)
+		{
+			return write_geometry(std::vector<geometry_counts>{ geometry_counts{ vertex_count, index_count } }).front();
+		}
+
+		// Like write_geometry, for a single part of vertices drawn in order.
+		[[nodiscard]] vertex_span write_vertices(const size_t count)
+		{
+			return write_geometry(count, 0).vertices;
+		}
+
+		// Vertices drawn in order, split into parts of the most vertices a part can have.
+		[[nodiscard]] std::vector<vertex_span> write_vertices_in_parts(const size_t count)
+		{
+			std::vector<geometry_counts> parts{};
+			for (size_t first = 0; first < count; first += MemoryManager::max_part_vertex_count)
+				parts.emplace_back(geometry_counts{ std::min(MemoryManager::max_part_vertex_count, count - first), 0 });
+
+			std::vector<vertex_span> result{};
+			for (const auto& part : write_geometry(parts)) result.emplace_back(part.vertices);
+
+			return result;
+		}
+
+		// Whether each part of the last written geometry is drawn, from the next drawn frame on. Parts past the
+		// end are.
+		void set_part_visibility(std::vector<bool> visible_parts)
+		{
+			memory_manager_.set_part_visibility(std::move(visible_parts));
+		}
 
-			for (const auto& [start, end] : wires)
-				vertices.emplace_back(start),
-				vertices.emplace_back(end);
+		// Of the images drawn to, which is what projections need to keep their proportions. Only changes when
+		// the artist adapts.
+		[[nodiscard]] vk::Extent2D get_extent() const
+		{
+			return swapchain_.get_configuration_view().extent;
+		}
 
-			set_vertices_to_draw(std::move(vertices));
+		// Called with the new extent whenever the artist adapted to its window, before the next frame is drawn.
+		void on_adapt(const adapt_callback& callback)
+		{
+			adapt_callbacks_.emplace_back(callback);
 		}
 
-		void set_vertices_to_draw(std::vector<GraphicsVertex> vertices) const
+		// Used from the next drawn frame on.
+		void set_uniforms(const frame_uniforms& uniforms)
 		{
-			memory_manager_.set_vertex_buffer(std::move(vertices));
+			uniforms_ = uniforms;
+		}
+
+
+		// Rolling statistics of where the time of the last drawn frames went, on the CPU and on the device.
+		[[nodiscard]] const frame_timings& get_frame_timings() const
+		{
+			return timings_;
+		}
+
+		void write_frame_timings_csv(const std::string& path) const
+		{
+			timings_.write_csv(path);
+		}
+
+		// How long creating the graphics pipeline took the last time, at startup or when adapting, and whether
+		// the pipeline cache was loaded from disk for it.
+		[[nodiscard]] std::chrono::microseconds get_pipeline_creation_time() const
+		{
+			return pipeline_.pipeline_creation_time();
+		}
+
+		[[nodiscard]] bool is_pipeline_cache_warm() const
+		{
+			return pipeline_.is_pipeline_cache_warm();
+		}
+
+		// How long adapting to the window took the last time, which is the latency of a resize, without waiting
+		// for a minimized window to come back. Zero before the first time.
+		[[nodiscard]] std::chrono::microseconds get_adapt_time() const
+		{
+			return adapt_time_;
 		}
 
 
@@ -206,6 +356,8 @@ namespace il
 		std::weak_ptr<const window> window_;
 
 		const std::shared_ptr<const device> device_;
+		// Declared right after the device, so that it outlives everything retired into it.
+		retired_objects retired_{};
 
 		
 		swapchain swapchain_;
@@ -213,9 +365,11 @@ namespace il
 		pipeline pipeline_;
 
 		
-		static constexpr std::array<vk::PipelineStageFlags, 1> wait_stages
+		// Of the acquired image and of the geometry upload.
+		static constexpr std::array<vk::PipelineStageFlags, 2> wait_stages
 		{
-			vk::PipelineStageFlagBits::eColorAttachmentOutput
+			vk::PipelineStageFlagBits::eColorAttachmentOutput,
+			vk::PipelineStageFlagBits::eVertexInput
 		};
 
 		static inline const size_t max_frames_in_flight = 2;
@@ -228,7 +382,18 @@ namespace il
 		const synchronizer<> sync_;
 
 
-		bool window_resized_ = false;
+		// Resizes are adapted to once the window kept its size for this long, so that dragging its border
+		// doesn't recreate the swapchain for every size in between. A suboptimal swapchain still presents and
+		// waits the same way; only one that is out of date is recreated right away.
+		static constexpr std::chrono::milliseconds resize_settle_time{ 50 };
+		std::optional<std::chrono::steady_clock::time_point> last_resize_time_{};
+
+		std::vector<adapt_callback> adapt_callbacks_{};
+
+		frame_uniforms uniforms_{};
+
+		frame_timings timings_{};
+		std::chrono::microseconds adapt_time_{};
 
 
 		
@@ -241,10 +406,27 @@ namespace il
 		{
 			window.on_resize([&](vk::Extent2D)
 				{
-					window_resized_ = true;
+					last_resize_time_ = std::chrono::steady_clock::now();
 				});
 		}
 
+		// Counts as a resize unless one is pending already, which it most likely comes from.
+		void note_suboptimal_swapchain()
+		{
+			if (last_resize_time_.has_value()) return;
+
+#if !defined(NDEBUG)
+			std::cerr << "Swapchain is suboptimal." << std::endl;
+#endif
+			last_resize_time_ = std::chrono::steady_clock::now();
+		}
+
+		[[nodiscard]] bool is_resize_settled() const
+		{
+			return last_resize_time_.has_value() &&
+				std::chrono::steady_clock::now() - last_resize_time_.value() >= resize_settle_time;
+		}
+
 		void adapt()
 		{
 			if (!window_.expired())
@@ -258,16 +440,36 @@ namespace il
 					shared_window->wait_events();
 				}
 
-				wait_idle();
+				last_resize_time_.reset();
+				const auto start = std::chrono::steady_clock::now();
+
+				// Frames in flight keep drawing with what the new extent replaces, which is retired until they
+				// are done. Only a new image format or count changes what they share with the frames after,
+				// which is rare enough to wait for them.
+				const auto old_configuration = swapchain_.get_configuration();
+				swapchain_.reconstruct(*device_, *shared_window, retired_);
+
+				const auto& configuration = swapchain_.get_configuration_view();
+				if (configuration.format != old_configuration.format ||
+					configuration.image_count != old_configuration.image_count)
+				{
+					wait_idle();
+					retired_.release_all();
+				}
 
-				swapchain_.reconstruct(*device_, *shared_window);
 				memory_manager_.reconstruct(swapchain_);
-				pipeline_.reconstruct(*device_, swapchain_, memory_manager_);
+				pipeline_.reconstruct(*device_, swapchain_, memory_manager_, retired_);
+				image_in_flight_fence_indices_.resize(configuration.image_count);
+
+				adapt_time_ = std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - start);
 
 #if !defined(NDEBUG)
-				std::cout << std::endl << "---- Artist adapted ----" << std::endl <<
+				std::cout << std::endl << "---- Artist adapted in " << adapt_time_.count() << " us ----" << std::endl <<
 					std::endl << std::endl;
 #endif
+
+				for (const auto& callback : adapt_callbacks_) callback(configuration.extent);
 			}
 			else
 			{
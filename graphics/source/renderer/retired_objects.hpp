@@ -0,0 +1,73 @@
+#ifndef GRAPHICS_RETIRED_OBJECTS_HPP
+#define GRAPHICS_RETIRED_OBJECTS_HPP
+
+
+#include "../external/pch.hpp"
+
+
+namespace il
+{
+	// Objects replaced while frames in flight may still use them, like a swapchain and its framebuffers after a
+	// resize. Each one is kept until the frames submitted before it was retired are done, so replacing them
+	// never waits for the device. Objects retired together are destroyed in reverse, so dependent objects go
+	// before what they depend on if they were created after it.
+	struct retired_objects
+	{
+		// Keeps the object until all frames submitted so far are done.
+		template<typename Object>
+		void retire(Object object)
+		{
+			objects_.emplace_back(
+				retired_object
+				{
+					submitted_frame_count_,
+					std::make_shared<Object>(std::move(object))
+				});
+		}
+
+		void count_submitted_frame()
+		{
+			++submitted_frame_count_;
+		}
+
+		// To be called once the fence of the frame about to be recorded was waited for, so that all submitted
+		// frames except the last frames_in_flight - 1 are done.
+		void release_done(const size_t frames_in_flight)
+		{
+			const auto done_frame_count = submitted_frame_count_ + 1 > frames_in_flight ?
+				submitted_frame_count_ + 1 - frames_in_flight :
+				0;
+
+			const auto done_end = std::find_if(objects_.begin(), objects_.end(),
+				[done_frame_count](const retired_object& object)
+				{
+					return object.submitted_frame_count > done_frame_count;
+				});
+
+			// Destroyed in reverse, from the last done object on.
+			for (auto object = done_end; object != objects_.begin();) (--object)->object.reset();
+
+			objects_.erase(objects_.begin(), done_end);
+		}
+
+		// Only when the device is idle.
+		void release_all()
+		{
+			while (!objects_.empty()) objects_.pop_back();
+		}
+
+	private:
+		struct retired_object
+		{
+			// Frames that may still use it.
+			size_t submitted_frame_count;
+			std::shared_ptr<void> object;
+		};
+
+		size_t submitted_frame_count_ = 0;
+		std::deque<retired_object> objects_{};
+	};
+}
+
+
+#endif
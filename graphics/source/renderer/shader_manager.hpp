@@ -31,11 +31,16 @@ namespace il
 
             for (const auto &request : configuration)
             {
+                const auto code = read_shader_file(request.path);
+
+                _code_hash = hash_bytes(&request.shader_stage_flag, sizeof(request.shader_stage_flag), _code_hash);
+                _code_hash = hash_bytes(code.data(), code.size(), _code_hash);
+
                 _shader_modules[i] = _create_shader_module(
 #if !defined(NDEBUG)
                         request.shader_stage_flag,
 #endif
-                        read_shader_file(request.path),
+                        code,
                         device
                 );
 
@@ -62,6 +67,12 @@ namespace il
 #pragma clang diagnostic pop
         }
 
+        // Identifies the stages and their code, so that anything built from them can tell when they change.
+        [[nodiscard, maybe_unused]] std::uint64_t code_hash() const noexcept
+        {
+            return _code_hash;
+        }
+
 
     private:
         struct shader_index
@@ -75,6 +86,8 @@ namespace il
         static inline const char *_shader_main_function_name = "main";
         std::vector<vk::PipelineShaderStageCreateInfo> _shader_stages_create_info;
 
+        std::uint64_t _code_hash{hash_bytes(nullptr, 0)};
+
 
         [[nodiscard]] static vk::UniqueShaderModule _create_shader_module(
 #if !defined(NDEBUG)
@@ -6,6 +6,7 @@
 
 #include "../environment/device.hpp"
 #include "env/window.hpp"
+#include "retired_objects.hpp"
 
 
 namespace il
@@ -46,10 +47,15 @@ namespace il
 			return swapchain_configuration_;
 		}
 
-		void reconstruct(const device& device, const window& window)
+		// The driver takes over from the old swapchain, which is retired, since frames in flight may still
+		// present its images.
+		void reconstruct(const device& device, const window& window, retired_objects& retired)
 		{
 			swapchain_configuration_ = select_swapchain_configuration(device, window);
-			inner_ = create_inner(device, window, *this->inner_);
+
+			auto old = std::move(inner_);
+			inner_ = create_inner(device, window, *old);
+			retired.retire(std::move(old));
 
 #if !defined(NDEBUG)
 			std::cout << std::endl << "-- Swapchain reconstructed --" << std::endl << std::endl;
@@ -47,6 +47,11 @@ namespace il
 			viewpoint_ = std::move(new_viewpoint);
 		}
 
+		[[nodiscard]] rational_number projection_plane_distance() const
+		{
+			return projection_plane_distance_;
+		}
+
 		
 		constexpr explicit camera(
 			point viewpoint,
@@ -93,6 +98,47 @@ namespace il
 			};
 		}
 
+		// Same projection as a transformation. The homogeneous component of the result is z scaled by the
+		// projection plane distance, so dividing by it gives get_projection and its sign tells if the point
+		// is in front of the camera.
+		template<typename Dummy = void, std::enable_if_t<
+			std::is_same_v<Dummy, void> && dimension_count == d3::dimension_count,
+			int> = 0>
+		[[nodiscard]] d3::transformation get_projection_transformation() const
+		{
+			return
+				transpose(
+					d3::transformation
+					{
+						1.0f, 0.0f, 0.0f, 0.0f,
+						0.0f, 1.0f, 0.0f, 0.0f,
+						0.0f, 0.0f, 1.0f, 1.0f / projection_plane_distance_,
+						0.0f, 0.0f, 0.0f, 0.0f
+					});
+		}
+
+		// Projection transformation for the GPU. Keeps the homogeneous component of get_projection_transformation
+		// and maps depth from the near to the far distance onto [0, 1], which Vulkan clips to.
+		template<typename Dummy = void, std::enable_if_t<
+			std::is_same_v<Dummy, void> && dimension_count == d3::dimension_count,
+			int> = 0>
+		[[nodiscard]] d3::transformation get_clip_transformation(
+			const rational_number near_distance,
+			const rational_number far_distance) const
+		{
+			const auto depth_scale = far_distance / (far_distance - near_distance);
+
+			return
+				transpose(
+					d3::transformation
+					{
+						1.0f, 0.0f, 0.0f, 0.0f,
+						0.0f, 1.0f, 0.0f, 0.0f,
+						0.0f, 0.0f, depth_scale / projection_plane_distance_, 1.0f / projection_plane_distance_,
+						0.0f, 0.0f, -depth_scale * near_distance / projection_plane_distance_, 0.0f
+					});
+		}
+
 
 		template<typename Dummy = void, std::enable_if_t<
 			std::is_same_v<Dummy, void>&& dimension_count == d3::dimension_count,
@@ -54,6 +54,31 @@ namespace il
 			return position_;
 		}
 
+		[[nodiscard]] rational_number ambient_intensity() const
+		{
+			return ambient_intensity_;
+		}
+
+		[[nodiscard]] rational_number diffuse_intensity() const
+		{
+			return diffuse_intensity_;
+		}
+
+		[[nodiscard]] rational_number specular_intensity() const
+		{
+			return specular_intensity_;
+		}
+
+		[[nodiscard]] small_natural_number shine() const
+		{
+			return shine_;
+		}
+
+		[[nodiscard]] const color& hue() const
+		{
+			return hue_;
+		}
+
 		
 		explicit light_source(
 			point position,
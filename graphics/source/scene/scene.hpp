@@ -0,0 +1,362 @@
+#ifndef IRGLAB_SCENE_HPP
+#define IRGLAB_SCENE_HPP
+
+
+#include "../external/pch.hpp"
+
+#include "../geometry/indexed_body.hpp"
+#include "../geometry/frustum.hpp"
+
+#include "camera.hpp"
+#include "light_source.hpp"
+
+
+namespace il
+{
+	// Bodies, a light and a camera kept between frames. Vertices are in world space and only change when
+	// bodies do, so they can stay on the GPU while the camera and the light move; view, projection and
+	// lighting are applied by the vertex shader from the transformations and the light handed out here.
+	// Vertices and the indices into them are written straight to where they are drawn from instead of being
+	// kept here, in parts of at most as many vertices and indices as the renderer takes for one draw. A body
+	// within those limits is a part of its own; a larger one is split by its triangles into parts that each
+	// have the vertices they use.
+	//
+	// Parts of bodies whose bounding boxes are outside of the view frustum of the screen are left out of the
+	// draws. Back faces are left to the rasterizer, which culls clockwise triangles, and clipping to the GPU,
+	// which clips to the depth range of get_clip_transformation.
+	//
+	// Mutable body accessors count as changes of the body. Vertex needs to be constructible from a world space
+	// position, a color and a normal.
+	template<typename Vertex>
+	class [[maybe_unused]] retained_scene final
+	{
+	public:
+		using body_id = size_t;
+		using color = d3::light_source::color;
+
+		struct part_counts
+		{
+			size_t vertex_count;
+			size_t index_count;
+		};
+
+		struct part_changes
+		{
+			// Whether any body changed since the last update, so that its parts need to be written.
+			bool is_changed{ false };
+
+			// For each part, the one it was before the update if its body didn't change, so that what was written
+			// for that one can be kept. Nothing for parts of new or changed bodies, which need to be written.
+			std::vector<std::optional<size_t>> previous_parts{};
+		};
+
+		static inline const rational_number near_distance = 0.01f;
+		static inline const rational_number far_distance = 100.0f;
+
+
+		explicit retained_scene(
+			d3::camera camera,
+			d3::light_source light,
+			const size_t max_part_vertex_count = std::numeric_limits<size_t>::max(),
+			const size_t max_part_index_count = std::numeric_limits<size_t>::max()) :
+			camera_{ std::move(camera) },
+			light_{ std::move(light) },
+			max_part_vertex_count_{ max_part_vertex_count },
+			max_part_index_count_{ max_part_index_count }
+		{
+			if (std::min(max_part_vertex_count, max_part_index_count) < 3)
+			{
+				throw std::invalid_argument("Scene parts need room for at least one triangle.");
+			}
+		}
+
+
+		// Bodies
+
+		body_id add_body(d3::convex_indexed_body body, color hue)
+		{
+			bodies_.emplace_back(body_entry{ std::move(body), std::move(hue) });
+
+			return bodies_.size() - 1;
+		}
+
+		[[nodiscard]] size_t body_count() const
+		{
+			return bodies_.size();
+		}
+
+		[[nodiscard]] const d3::convex_indexed_body& body(const body_id id) const
+		{
+			return bodies_.at(id).body;
+		}
+
+		[[nodiscard]] d3::convex_indexed_body& modify_body(const body_id id)
+		{
+			auto& entry = bodies_.at(id);
+			entry.is_changed = true;
+
+			return entry.body;
+		}
+
+
+		// Camera and light
+
+		[[nodiscard]] const d3::camera& camera() const
+		{
+			return camera_;
+		}
+
+		[[nodiscard]] d3::camera& modify_camera()
+		{
+			return camera_;
+		}
+
+		[[nodiscard]] const d3::light_source& light() const
+		{
+			return light_;
+		}
+
+		[[nodiscard]] d3::light_source& modify_light()
+		{
+			return light_;
+		}
+
+
+		// Output
+
+		// Splits the bodies that changed since the last update into parts again and returns which parts need to
+		// be written. Parts of the other bodies stay as they are and only move when a body before them ends up
+		// with a different number of parts. Camera and light changes don't touch them.
+		part_changes update()
+		{
+			part_changes result{};
+			result.is_changed = std::any_of(
+				bodies_.begin(),
+				bodies_.end(),
+				[](const body_entry& entry) { return entry.is_changed; });
+
+			if (!result.is_changed) return result;
+
+			auto previous_parts = std::move(parts_);
+			parts_.clear();
+
+			for (body_id id = 0; id < bodies_.size(); ++id)
+			{
+				auto& entry = bodies_[id];
+				const auto first_part = parts_.size();
+
+				if (entry.is_changed)
+				{
+					add_parts(id);
+					result.previous_parts.resize(parts_.size());
+				}
+				else
+				{
+					for (size_t i = entry.first_part; i < entry.first_part + entry.part_count; ++i)
+					{
+						parts_.emplace_back(previous_parts[i]);
+						result.previous_parts.emplace_back(i);
+					}
+				}
+
+				entry.is_changed = false;
+				entry.first_part = first_part;
+				entry.part_count = parts_.size() - first_part;
+			}
+
+			return result;
+		}
+
+		// Of every part as of the last update, in order.
+		[[nodiscard]] std::vector<part_counts> get_part_counts() const
+		{
+			std::vector<part_counts> result{};
+			result.reserve(parts_.size());
+
+			for (const auto& part : parts_) result.emplace_back(part_counts{ part.vertex_count, 3 * part.triangle_count });
+
+			return result;
+		}
+
+		[[nodiscard]] body_id part_body(const size_t part_index) const
+		{
+			return parts_.at(part_index).body;
+		}
+
+		// Whether each part as of the last update may be on screen, which it may unless the bounding box of its
+		// body is outside of the view frustum. Without a screen extent set, all of them may.
+		[[nodiscard]] std::vector<bool> get_visible_parts()
+		{
+			if (!frustum_.has_value()) return std::vector<bool>(parts_.size(), true);
+
+			const auto view = view_transformation();
+
+			std::vector<bool> visible_bodies(bodies_.size());
+			for (body_id id = 0; id < bodies_.size(); ++id)
+				visible_bodies[id] = frustum_->classify(bodies_[id].body.get_aabb(), view) != containment::outside;
+
+			std::vector<bool> result(parts_.size());
+			for (size_t i = 0; i < parts_.size(); ++i) result[i] = visible_bodies[parts_[i].body];
+
+			return result;
+		}
+
+		// Writes the vertices of the part, each with its normal so that lighting stays smooth, and three indices
+		// per triangle into them, counted from the first vertex of the part. Vertices shared within the part
+		// are written and transformed once.
+		template<typename VertexOutput, typename IndexOutput>
+		void write_part(const size_t part_index, VertexOutput vertex_destination, IndexOutput index_destination) const
+		{
+			const auto& part = parts_.at(part_index);
+			const auto& entry = bodies_[part.body];
+			const auto& vertex_normals = entry.body.get_vertex_normals();
+
+			const auto write_vertex = [&](const size_t index)
+			{
+				*vertex_destination++ =
+					Vertex
+					{
+						d3::to_cartesian_coordinates(entry.body.get_point(static_cast<vertex_index>(index))),
+						entry.hue,
+						vertex_normals[index]
+					};
+			};
+
+			const auto first_triangle = entry.body.triangles().begin() +
+				static_cast<std::ptrdiff_t>(part.first_triangle);
+			const auto end_triangle = first_triangle + static_cast<std::ptrdiff_t>(part.triangle_count);
+
+			if (part.is_whole_body)
+			{
+				for (size_t i = 0; i < entry.body.vertex_count(); ++i) write_vertex(i);
+
+				for (auto triangle = first_triangle; triangle != end_triangle; ++triangle)
+					for (const auto index : *triangle) *index_destination++ = static_cast<std::uint32_t>(index);
+
+				return;
+			}
+
+			// Vertices are numbered in the order the triangles of the part first use them.
+			std::vector<std::uint32_t> part_indices(entry.body.vertex_count(), no_part_index);
+			std::uint32_t part_vertex_count = 0;
+
+			for (auto triangle = first_triangle; triangle != end_triangle; ++triangle)
+			{
+				for (const auto index : *triangle)
+				{
+					auto& part_index = part_indices[index];
+					if (part_index == no_part_index)
+					{
+						part_index = part_vertex_count++;
+						write_vertex(index);
+					}
+
+					*index_destination++ = part_index;
+				}
+			}
+		}
+
+		[[nodiscard]] d3::transformation view_transformation()
+		{
+			return camera_.get_view_transformation();
+		}
+
+		[[nodiscard]] d3::transformation clip_transformation() const
+		{
+			return camera_.get_clip_transformation(near_distance, far_distance);
+		}
+
+
+		// Screen
+
+		// Culls against the view frustum of a screen of the given size from now on. A screen without area, like
+		// the one of a minimized window, keeps the last frustum, since nothing of it is seen anyway.
+		void set_screen_extent(const std::uint32_t width, const std::uint32_t height)
+		{
+			auto frustum = view_frustum::for_extent(camera_.projection_plane_distance(), width, height, near_distance);
+			if (frustum.has_value()) frustum_ = std::move(frustum);
+		}
+
+
+	private:
+		struct body_entry
+		{
+			d3::convex_indexed_body body;
+			color hue;
+
+			// Since the last update, which splits it into parts again then.
+			bool is_changed{ true };
+
+			// Range of its parts as of the last update.
+			size_t first_part{ 0 };
+			size_t part_count{ 0 };
+		};
+
+		// Consecutive triangles of a body.
+		struct part
+		{
+			body_id body;
+
+			size_t first_triangle;
+			size_t triangle_count;
+			size_t vertex_count;
+
+			// All of its vertices in body order, which need no renumbering.
+			bool is_whole_body;
+		};
+
+		static constexpr std::uint32_t no_part_index = std::numeric_limits<std::uint32_t>::max();
+
+
+		d3::camera camera_;
+		d3::light_source light_;
+
+		std::vector<body_entry> bodies_{};
+
+		const size_t max_part_vertex_count_;
+		const size_t max_part_index_count_;
+		std::vector<part> parts_{};
+
+		std::optional<view_frustum> frustum_{};
+
+
+		void add_parts(const body_id id)
+		{
+			const auto& body = bodies_[id].body;
+
+			if (body.vertex_count() <= max_part_vertex_count_ && 3 * body.triangle_count() <= max_part_index_count_)
+			{
+				parts_.emplace_back(part{ id, 0, body.triangle_count(), body.vertex_count(), true });
+				return;
+			}
+
+			// No part uses more than three vertices per triangle.
+			const auto max_triangle_count = std::min(max_part_vertex_count_, max_part_index_count_) / 3;
+
+			// Number of the part of the body each vertex was last counted for, from one on.
+			std::vector<size_t> counted_parts(body.vertex_count(), 0);
+
+			for (size_t first = 0; first < body.triangle_count(); first += max_triangle_count)
+			{
+				const auto count = std::min(max_triangle_count, body.triangle_count() - first);
+				const auto part_number = first / max_triangle_count + 1;
+
+				size_t vertex_count = 0;
+				for (size_t i = first; i < first + count; ++i)
+				{
+					for (const auto index : body.triangles()[i])
+					{
+						if (counted_parts[index] == part_number) continue;
+
+						counted_parts[index] = part_number;
+						++vertex_count;
+					}
+				}
+
+				parts_.emplace_back(part{ id, first, count, vertex_count, false });
+			}
+		}
+	};
+}
+
+#endif